@@ -0,0 +1,160 @@
+/**
+ * @file bench_containers.cpp
+ * @brief Compares standard containers on HeapEngine with std::allocator.
+ *
+ * Each workload runs three times with the same random sequence: with
+ * std::allocator, with heap_engine::allocator<T> and as a std::pmr
+ * container on heap_engine::get_memory_resource(). The runs must agree on
+ * a checksum of the container contents.
+ *
+ * - map: random insert/erase on a std::map, one node per operation;
+ * - vector: vectors grown by push_back to random lengths, then dropped.
+ *
+ * Both are sized from HEAP_SIZE; configure a large heap for meaningful
+ * numbers, e.g.
+ * cmake -S . -B build-bench -DHEAP_BACKEND=3 -DHEAP_SIZE=4194304 \
+ *       -DCMAKE_BUILD_TYPE=Release
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "bench_util.h"
+#include "heap_engine.hpp"
+
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t MAP_STEPS = 200000;
+
+/** Keys in the map workload: about a tenth of the heap at 100 B a node. */
+constexpr std::size_t MAP_KEYS =
+    HEAP_SIZE / 1024 < 16 ? 16 : (std::size_t) HEAP_SIZE / 1024;
+
+/** Longest vector: its final buffer takes at most a 256th of the heap. */
+constexpr std::size_t VECTOR_MAX =
+    HEAP_SIZE / 1024 < 16 ? 16 : (std::size_t) HEAP_SIZE / 1024;
+
+/**
+ * Rounds of the vector workload: about a quarter of a heap of buffers.
+ * First-fit only merges a freed block with the one after it, so the
+ * buffers a growing vector leaves behind stay apart; many more rounds
+ * fragment any heap until it runs out.
+ */
+constexpr std::size_t VECTOR_ROUNDS =
+    HEAP_SIZE / (VECTOR_MAX * sizeof(uint32_t) * 4);
+
+struct Result {
+    uint64_t ns;
+    uint64_t checksum;
+    bool exhausted; ///< The heap ran out; ns and checksum are partial.
+};
+
+template <class Map> Result map_churn(Map map) {
+    allocator_init(); // Every run starts on a fresh heap.
+    uint64_t rng = 11;
+    Result result = {0, 0, false};
+    uint64_t start = bench_now_ns();
+    try {
+        for (std::size_t step = 0; step < MAP_STEPS; step++) {
+            uint32_t key = bench_rand(&rng) % MAP_KEYS;
+            if (bench_rand(&rng) & 1) {
+                map[key] = (uint32_t) step;
+            } else {
+                result.checksum += map.erase(key);
+            }
+        }
+    } catch (const std::bad_alloc &) {
+        result.exhausted = true;
+    }
+    for (const auto &entry : map) {
+        result.checksum += entry.first ^ entry.second;
+    }
+    map.clear();
+    result.ns = bench_now_ns() - start;
+    return result;
+}
+
+template <class Vector> Result vector_growth(const Vector &empty) {
+    allocator_init(); // Every run starts on a fresh heap.
+    uint64_t rng = 13;
+    Result result = {0, 0, false};
+    uint64_t start = bench_now_ns();
+    try {
+        for (std::size_t round = 0; round < VECTOR_ROUNDS; round++) {
+            Vector vector(empty.get_allocator());
+            std::size_t length = 1 + bench_rand(&rng) % VECTOR_MAX;
+            for (std::size_t i = 0; i < length; i++) {
+                vector.push_back((uint32_t) (round + i));
+            }
+            result.checksum += vector[length / 2] + vector.capacity();
+        }
+    } catch (const std::bad_alloc &) {
+        result.exhausted = true;
+    }
+    result.ns = bench_now_ns() - start;
+    return result;
+}
+
+void print_run(const char *name, const Result &run, std::size_t ops) {
+    if (run.exhausted) {
+        std::printf("  %s: heap exhausted", name);
+    } else {
+        std::printf("  %s: %.1f ns/op", name, (double) run.ns / (double) ops);
+    }
+}
+
+bool report(const char *workload, std::size_t ops, const Result &std_run,
+            const Result &engine_run, const Result &pmr_run) {
+    std::printf("%-7s", workload);
+    print_run("std::allocator", std_run, ops);
+    print_run("heap_engine::allocator", engine_run, ops);
+    print_run("pmr", pmr_run, ops);
+    std::printf("\n");
+
+    // Only complete runs must agree.
+    for (const Result *run : {&engine_run, &pmr_run}) {
+        if (!run->exhausted && run->checksum != std_run.checksum) {
+            std::fprintf(stderr, "%s: checksums differ\n", workload);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    using Key = uint32_t;
+    using Value = uint32_t;
+    using EngineMap =
+        std::map<Key, Value, std::less<Key>,
+                 heap_engine::allocator<std::pair<const Key, Value>>>;
+    using EngineVector =
+        std::vector<uint32_t, heap_engine::allocator<uint32_t>>;
+
+    allocator_init();
+    std::printf("HeapEngine container benchmark (policy %d, HEAP_SIZE=%zu)\n",
+                HEAP_POLICY, (std::size_t) HEAP_SIZE);
+
+    bool ok = true;
+    ok &= report("map", MAP_STEPS, map_churn(std::map<Key, Value>()),
+                 map_churn(EngineMap()),
+                 map_churn(std::pmr::map<Key, Value>(
+                     heap_engine::get_memory_resource())));
+
+    // Vector growth is counted per element pushed, on average.
+    std::size_t pushes = VECTOR_ROUNDS * (VECTOR_MAX + 1) / 2;
+    ok &= report("vector", pushes, vector_growth(std::vector<uint32_t>()),
+                 vector_growth(EngineVector()),
+                 vector_growth(std::pmr::vector<uint32_t>(
+                     heap_engine::get_memory_resource())));
+
+    allocator_destroy();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/**
+ * @file bench_false_sharing.c
+ * @brief Measures false sharing between per-thread counters.
+ *
+ * Each thread allocates one 8-byte counter and increments it COUNTER_STEPS
+ * times. The threads allocate at the same moment, so:
+ *
+ * - packed: with my_malloc(), the counters land in neighbouring blocks,
+ *   several to a cache line, and every increment fights the other threads
+ *   for the line;
+ * - isolated: with HINT_ISOLATED, each counter sits in its own thread's
+ *   run, and the threads never touch each other's lines.
+ *
+ * Needs HEAP_ISOLATION and more than one core, e.g.
+ * cmake -S . -B build -DHEAP_ISOLATION=ON -DCMAKE_BUILD_TYPE=Release
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "bench_util.h"
+#include "my_allocator.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define COUNTER_STEPS 20000000
+#define MAX_THREADS 8
+
+typedef struct {
+    pthread_barrier_t *start;
+    unsigned hints;
+    _Atomic uint64_t *counter; ///< Set by the thread
+    uint64_t total;            ///< Final counter value
+} Worker;
+
+static void *count(void *arg) {
+    Worker *worker = (Worker *) arg;
+    pthread_barrier_wait(worker->start);
+    worker->counter = (_Atomic uint64_t *) my_malloc_hint(
+        sizeof(*worker->counter), worker->hints);
+    pthread_barrier_wait(worker->start);
+    if (worker->counter == NULL) {
+        return NULL;
+    }
+
+    atomic_init(worker->counter, 0);
+    for (int i = 0; i < COUNTER_STEPS; i++) {
+        atomic_fetch_add_explicit(worker->counter, 1, memory_order_relaxed);
+    }
+    worker->total = atomic_load(worker->counter);
+    return NULL;
+}
+
+/**
+ * @brief Runs 'threads' counting threads allocating with 'hints'.
+ *
+ * @return Nanoseconds per increment, or a negative value on failure.
+ */
+static double run(int threads, unsigned hints, int *lines) {
+    pthread_barrier_t start;
+    pthread_t ids[MAX_THREADS];
+    Worker workers[MAX_THREADS];
+
+    allocator_init();
+    pthread_barrier_init(&start, NULL, (unsigned) threads + 1);
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (Worker) {&start, hints, NULL, 0};
+        pthread_create(&ids[t], NULL, count, &workers[t]);
+    }
+    // The first barrier starts the allocations, the second the counting.
+    pthread_barrier_wait(&start);
+    pthread_barrier_wait(&start);
+    uint64_t begin = bench_now_ns();
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - begin;
+
+    // Count the distinct lines the counters ended up on.
+    bool ok = true;
+    *lines = 0;
+    for (int t = 0; t < threads; t++) {
+        ok &= workers[t].total == COUNTER_STEPS;
+        uintptr_t line = (uintptr_t) workers[t].counter / HEAP_CACHE_LINE;
+        bool seen = false;
+        for (int u = 0; u < t; u++) {
+            seen |= (uintptr_t) workers[u].counter / HEAP_CACHE_LINE == line;
+        }
+        *lines += !seen;
+    }
+    for (int t = 0; t < threads; t++) {
+        my_free((void *) workers[t].counter);
+    }
+    pthread_barrier_destroy(&start);
+    return ok ? (double) elapsed / COUNTER_STEPS : -1.0;
+}
+
+int main(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores < 2 ? 2 : cores > MAX_THREADS ? MAX_THREADS
+                                                      : (int) cores;
+
+    printf("HeapEngine false-sharing benchmark (%d threads, %d increments "
+           "each, %d-byte lines)\n",
+           threads, COUNTER_STEPS, HEAP_CACHE_LINE);
+
+    int packed_lines = 0;
+    int isolated_lines = 0;
+    double packed = run(threads, HINT_NONE, &packed_lines);
+    double isolated = run(threads, HINT_ISOLATED, &isolated_lines);
+    if (packed < 0 || isolated < 0) {
+        fprintf(stderr, "counting failed: heap too small?\n");
+        return 1;
+    }
+
+    printf("packed:   %6.2f ns/increment, counters on %d lines\n", packed,
+           packed_lines);
+    printf("isolated: %6.2f ns/increment, counters on %d lines\n", isolated,
+           isolated_lines);
+    printf("false-sharing slowdown removed: %.1fx\n", packed / isolated);
+
+    allocator_destroy();
+    return isolated_lines == threads ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file bench_free_index.c
+ * @brief Compares first-fit search by list walk and by the free-block index.
+ *
+ * The heap is first fragmented into N small holes, each pinned in place by
+ * a live neighbour, so every free-list search has to look past up to N
+ * blocks that are too small. Two workloads are then timed, once with the
+ * index disabled and once with it enabled:
+ *
+ * - miss: a batch of 64-byte allocations that no hole can serve, so each
+ *   search crosses every hole (the worst case of a fragmented heap);
+ * - churn: random 16-512 byte allocations with a sliding window of live
+ *   blocks, where recently freed blocks usually fit early in the list.
+ *
+ * Configure with a large heap to get meaningful numbers, e.g.
+ * cmake -S . -B build -DHEAP_BACKEND=3 -DHEAP_SIZE=4194304 \
+ *       -DHEAP_FREE_INDEX=ON -DCMAKE_BUILD_TYPE=Release
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "bench_util.h"
+#include "my_allocator.h"
+#include <stdio.h>
+
+#define HOLE_SIZE 32
+#define MISS_SIZE 64
+#define MISS_BATCH 512
+#define CHURN_WINDOW 32 ///< Live blocks during the churn.
+#define CHURN_STEPS 20000
+
+/** @brief Fragmentation levels, clamped to what the heap can hold. */
+static const size_t levels[] = {16, 256, 4096, 16384};
+
+/** @brief Results of one run, in nanoseconds per allocation. */
+typedef struct {
+    double miss_ns;
+    double churn_ns;
+} RunResult;
+
+/**
+ * @brief Leaves 'holes' free HOLE_SIZE blocks, each followed by a live one.
+ *
+ * The holes are chained through their own memory and only freed at the
+ * end, so none of them is reused while the next ones are made.
+ *
+ * @return Number of holes actually made.
+ */
+static size_t fragment(size_t holes) {
+    void *chain = NULL;
+    size_t made = 0;
+    for (; made < holes; made++) {
+        void **hole = (void **) my_malloc(HOLE_SIZE);
+        void *pin = my_malloc(HOLE_SIZE);
+        if (pin == NULL) {
+            my_free(hole);
+            break;
+        }
+        *hole = chain;
+        chain = hole;
+    }
+    while (chain != NULL) {
+        void *next = *(void **) chain;
+        my_free(chain);
+        chain = next;
+    }
+    return made;
+}
+
+static RunResult run(size_t holes, bool indexed) {
+    static void *batch[MISS_BATCH];
+    void *window[CHURN_WINDOW] = {NULL};
+    RunResult result = {0};
+    uint64_t rng = 42;
+
+    allocator_set_free_index(indexed);
+    allocator_init();
+    fragment(holes);
+
+    size_t served = 0;
+    uint64_t start = bench_now_ns();
+    while (served < MISS_BATCH &&
+           (batch[served] = my_malloc(MISS_SIZE)) != NULL) {
+        served++;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    result.miss_ns = served > 0 ? (double) elapsed / (double) served : 0;
+    for (size_t i = 0; i < served; i++) {
+        my_free(batch[i]);
+    }
+
+    start = bench_now_ns();
+    for (size_t step = 0; step < CHURN_STEPS; step++) {
+        size_t slot = step % CHURN_WINDOW;
+        my_free(window[slot]);
+        window[slot] = my_malloc(16 + bench_rand(&rng) % 497);
+    }
+    elapsed = bench_now_ns() - start;
+    result.churn_ns = (double) elapsed / CHURN_STEPS;
+    for (size_t i = 0; i < CHURN_WINDOW; i++) {
+        my_free(window[i]);
+    }
+
+    allocator_destroy();
+    return result;
+}
+
+int main(void) {
+    printf("HeapEngine free-block index benchmark (HEAP_SIZE=%zu, "
+           "index capacity %zu)\n",
+           (size_t) HEAP_SIZE, (size_t) HEAP_FREE_INDEX_CAPACITY);
+    printf("%-8s %16s %16s %16s %16s\n", "holes", "miss walk ns",
+           "miss index ns", "churn walk ns", "churn index ns");
+
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        // Stay within the index, or both runs would walk the list.
+        size_t holes = levels[i];
+        if (holes > HEAP_FREE_INDEX_CAPACITY - 8) {
+            holes = HEAP_FREE_INDEX_CAPACITY - 8;
+        }
+
+        allocator_init();
+        size_t made = fragment(holes);
+        allocator_destroy();
+
+        RunResult walk = run(made, false);
+        RunResult index = run(made, true);
+        printf("%-8zu %16.1f %16.1f %16.1f %16.1f\n", made, walk.miss_ns,
+               index.miss_ns, walk.churn_ns, index.churn_ns);
+        if (holes < levels[i]) {
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/**
+ * @file bench_hints.c
+ * @brief Compares unhinted and hinted placement on a mixed-lifetime workload.
+ *
+ * Each step allocates one hot list node (kept and traversed at the end), a
+ * long-lived object every other step, and a few short-lived temporaries that
+ * are freed FIFO a little later. The same sequence is run once with plain
+ * my_malloc() and once with my_malloc_hint(). Afterwards we measure:
+ *
+ * - fragmentation: the largest block and the number of 256-byte blocks the
+ *   heap can still hand out;
+ * - locality: how many cache lines and pages the hot nodes span, and the
+ *   time per node of walking the hot list.
+ *
+ * Configure with a large heap to get meaningful numbers, e.g.
+ * cmake -S . -B build -DHEAP_BACKEND=3 -DHEAP_SIZE=4194304
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "bench_util.h"
+#include "my_allocator.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEMP_DEPTH 32  ///< Temporaries alive at once.
+#define TEMPS_PER_STEP 4
+#define WALKS 64 ///< Passes over the hot list when timing it.
+
+/** @brief Hot object: a list node that is walked repeatedly. */
+typedef struct HotNode {
+    struct HotNode *next;
+    uint64_t value;
+    char payload[16];
+} HotNode;
+
+/** @brief Results of one run. */
+typedef struct {
+    size_t hot_nodes;
+    size_t largest_block;
+    size_t blocks_256;
+    size_t hot_lines;
+    size_t hot_pages;
+    double walk_ns_per_node;
+} RunResult;
+
+static int compare_addr(const void *a, const void *b) {
+    uintptr_t x = *(const uintptr_t *) a;
+    uintptr_t y = *(const uintptr_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Counts the distinct 2^shift-byte units the hot nodes touch.
+ */
+static size_t count_units(uintptr_t *addrs, size_t count, unsigned shift) {
+    size_t units = 0;
+    uintptr_t last = UINTPTR_MAX;
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t first_unit = addrs[i] >> shift;
+        uintptr_t last_unit = (addrs[i] + sizeof(HotNode) - 1) >> shift;
+        for (uintptr_t unit = first_unit; unit <= last_unit; unit++) {
+            if (unit != last) {
+                units++;
+                last = unit;
+            }
+        }
+    }
+    return units;
+}
+
+/**
+ * @brief Finds the largest single allocation the heap can satisfy.
+ */
+static size_t largest_block(void) {
+    size_t low = 0;
+    size_t high = HEAP_SIZE;
+    while (low < high) {
+        size_t mid = low + (high - low + 1) / 2;
+        void *ptr = my_malloc(mid);
+        if (ptr != NULL) {
+            my_free(ptr);
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Counts how many 256-byte blocks still fit, then frees them.
+ */
+static size_t count_blocks_256(void) {
+    void **blocks = malloc((HEAP_SIZE / 256 + 1) * sizeof(void *));
+    size_t count = 0;
+    while (blocks != NULL && count <= HEAP_SIZE / 256 &&
+           (blocks[count] = my_malloc(256)) != NULL) {
+        count++;
+    }
+    for (size_t i = 0; i < count; i++) {
+        my_free(blocks[i]);
+    }
+    free(blocks);
+    return count;
+}
+
+static void *alloc(size_t size, unsigned hint, bool hinted) {
+    return hinted ? my_malloc_hint(size, hint) : my_malloc(size);
+}
+
+static RunResult run(bool hinted) {
+    RunResult result = {0};
+    const size_t steps = HEAP_SIZE / 512;
+    void *temps[TEMP_DEPTH] = {NULL};
+    size_t temp_next = 0;
+    HotNode *head = NULL;
+    uint64_t rng = 42;
+
+    allocator_init();
+
+    for (size_t step = 0; step < steps; step++) {
+        HotNode *node = (HotNode *) alloc(sizeof(HotNode), HINT_HOT, hinted);
+        if (node != NULL) {
+            node->value = step;
+            node->next = head;
+            head = node;
+            result.hot_nodes++;
+        }
+
+        if (step % 2 == 0) {
+            (void) alloc(48 + bench_rand(&rng) % 192, HINT_LONG_LIVED, hinted);
+        }
+
+        for (int t = 0; t < TEMPS_PER_STEP; t++) {
+            my_free(temps[temp_next]);
+            temps[temp_next] = alloc(16 + bench_rand(&rng) % 384,
+                                     HINT_SHORT_LIVED, hinted);
+            temp_next = (temp_next + 1) % TEMP_DEPTH;
+        }
+    }
+    for (size_t i = 0; i < TEMP_DEPTH; i++) {
+        my_free(temps[i]);
+    }
+
+    // Locality of the hot list.
+    uintptr_t *addrs = malloc((result.hot_nodes + 1) * sizeof(uintptr_t));
+    size_t n = 0;
+    for (const HotNode *node = head; node != NULL && addrs != NULL;
+         node = node->next) {
+        addrs[n++] = (uintptr_t) node;
+    }
+    if (addrs != NULL) {
+        qsort(addrs, n, sizeof(uintptr_t), compare_addr);
+        result.hot_lines = count_units(addrs, n, 6);
+        result.hot_pages = count_units(addrs, n, 12);
+        free(addrs);
+    }
+
+    uint64_t sum = 0;
+    uint64_t start = bench_now_ns();
+    for (int walk = 0; walk < WALKS; walk++) {
+        for (const HotNode *node = head; node != NULL; node = node->next) {
+            sum += node->value;
+        }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    if (result.hot_nodes > 0) {
+        result.walk_ns_per_node =
+            (double) elapsed / (double) (WALKS * result.hot_nodes);
+    }
+    if (sum == 1) {
+        puts(""); // Keep the walk from being optimized away.
+    }
+
+    // Fragmentation left behind by the long-lived and hot objects.
+    result.largest_block = largest_block();
+    result.blocks_256 = count_blocks_256();
+
+    allocator_destroy();
+    return result;
+}
+
+int main(void) {
+    RunResult plain = run(false);
+    RunResult hinted = run(true);
+
+    printf("HeapEngine allocation hint benchmark (HEAP_SIZE=%zu)\n",
+           (size_t) HEAP_SIZE);
+    printf("%-28s %14s %14s\n", "", "my_malloc", "my_malloc_hint");
+    printf("%-28s %14zu %14zu\n", "hot nodes", plain.hot_nodes,
+           hinted.hot_nodes);
+    printf("%-28s %14zu %14zu\n", "largest free block (bytes)",
+           plain.largest_block, hinted.largest_block);
+    printf("%-28s %14zu %14zu\n", "256-byte blocks still free",
+           plain.blocks_256, hinted.blocks_256);
+    printf("%-28s %14zu %14zu\n", "cache lines spanned by hot",
+           plain.hot_lines, hinted.hot_lines);
+    printf("%-28s %14zu %14zu\n", "pages spanned by hot", plain.hot_pages,
+           hinted.hot_pages);
+    printf("%-28s %14.2f %14.2f\n", "hot walk (ns/node)",
+           plain.walk_ns_per_node, hinted.walk_ns_per_node);
+    return 0;
+}
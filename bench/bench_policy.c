@@ -0,0 +1,103 @@
+/**
+ * @file bench_policy.c
+ * @brief Measures the configured allocation policy on power-of-two buffers.
+ *
+ * The workload mimics a page cache: buffers of 64 to 4096 bytes, always a
+ * power of two, with a sliding window of live buffers. Two things are
+ * measured:
+ *
+ * - churn: time per malloc/free pair, and how many requests failed;
+ * - fill: after the churn, buffers are allocated until the first failure,
+ *   and the bytes requested by all live buffers are compared with the heap
+ *   size.
+ *
+ * The policy is fixed at build time, so compare policies by building once
+ * per HEAP_POLICY, e.g.
+ * cmake -S . -B build-buddy -DHEAP_BACKEND=3 -DHEAP_SIZE=4194304 \
+ *       -DHEAP_POLICY=3 -DCMAKE_BUILD_TYPE=Release
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "bench_util.h"
+#include "my_allocator.h"
+#include <stdio.h>
+
+#define MIN_SHIFT 6 ///< Smallest buffer: 64 bytes
+#define SHIFTS 7    ///< Largest buffer: 4096 bytes
+#define CHURN_WINDOW 256
+#define CHURN_STEPS 200000
+#define FILL_MAX 65536 ///< Buffers kept by the fill phase at most.
+
+static const char *policy_name(void) {
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+    return "tlsf";
+#elif HEAP_POLICY == HEAP_POLICY_BUDDY
+    return "buddy";
+#else
+    return "first-fit";
+#endif
+}
+
+static size_t buffer_size(uint64_t *rng) {
+    return (size_t) 1 << (MIN_SHIFT + bench_rand(rng) % SHIFTS);
+}
+
+int main(void) {
+    static void *window[CHURN_WINDOW];
+    static size_t window_size[CHURN_WINDOW];
+    static void *filled[FILL_MAX];
+    uint64_t rng = 7;
+
+    allocator_init();
+
+    size_t failed = 0;
+    uint64_t start = bench_now_ns();
+    for (size_t step = 0; step < CHURN_STEPS; step++) {
+        size_t slot = bench_rand(&rng) % CHURN_WINDOW;
+        my_free(window[slot]);
+        window_size[slot] = buffer_size(&rng);
+        window[slot] = my_malloc(window_size[slot]);
+        failed += window[slot] == NULL;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    size_t live = 0;
+    size_t live_bytes = 0;
+    for (size_t i = 0; i < CHURN_WINDOW; i++) {
+        if (window[i] != NULL) {
+            live++;
+            live_bytes += window_size[i];
+        }
+    }
+
+    size_t fill_bytes = 0;
+    size_t count = 0;
+    for (; count < FILL_MAX; count++) {
+        size_t size = buffer_size(&rng);
+        filled[count] = my_malloc(size);
+        if (filled[count] == NULL) {
+            break;
+        }
+        fill_bytes += size;
+    }
+
+    printf("HeapEngine policy benchmark (policy %s, HEAP_SIZE=%zu)\n",
+           policy_name(), (size_t) HEAP_SIZE);
+    printf("churn: %.1f ns per malloc/free, %zu of %d requests failed, "
+           "%zu buffers live\n",
+           (double) elapsed / CHURN_STEPS, failed, CHURN_STEPS, live);
+    printf("fill: %zu more buffers, %zu bytes live (%.1f%% of the heap)\n",
+           count, live_bytes + fill_bytes,
+           100.0 * (double) (live_bytes + fill_bytes) / (double) HEAP_SIZE);
+
+    for (size_t i = 0; i < count; i++) {
+        my_free(filled[i]);
+    }
+    for (size_t i = 0; i < CHURN_WINDOW; i++) {
+        my_free(window[i]);
+    }
+    allocator_destroy();
+    return 0;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file bench_util.h
+ * @brief Small helpers shared by the HeapEngine benchmarks.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ */
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Deterministic pseudo-random numbers, so every run sees the same
+ * allocation sequence.
+ */
+static inline uint32_t bench_rand(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (uint32_t) (*state >> 33);
+}
+
+#endif // BENCH_UTIL_H
@@ -0,0 +1,133 @@
+/**
+ * @file heap_engine.hpp
+ * @brief C++ adapters: a std::pmr::memory_resource and an STL allocator
+ * over the HeapEngine heap.
+ *
+ * Both allocate from the one global heap, so they carry no state and any
+ * two instances are interchangeable. Memory is returned through
+ * my_free_sized(), which skips the header offset lookup, except for
+ * over-aligned types, which come from my_malloc_aligned() and go back
+ * through my_free(). allocator_init() must have been called before the
+ * first container allocates.
+ *
+ * Needs C++17.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_ENGINE_HPP
+#define HEAP_ENGINE_HPP
+
+#include "my_allocator.h"
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+
+namespace heap_engine {
+
+namespace detail {
+
+/**
+ * @brief Allocates 'bytes' at 'alignment', throwing std::bad_alloc on
+ * failure. Empty requests get one byte, as operator new does.
+ */
+inline void *allocate_bytes(std::size_t bytes, std::size_t alignment) {
+    if (bytes == 0) {
+        bytes = 1;
+    }
+    void *ptr = alignment <= ALIGNMENT ? my_malloc(bytes)
+                                       : my_malloc_aligned(alignment, bytes);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+/**
+ * @brief Frees memory from allocate_bytes() with the same arguments.
+ */
+inline void deallocate_bytes(void *ptr, std::size_t bytes,
+                             std::size_t alignment) noexcept {
+    if (alignment <= ALIGNMENT) {
+        my_free_sized(ptr, bytes == 0 ? 1 : bytes);
+    } else {
+        my_free(ptr);
+    }
+}
+
+} // namespace detail
+
+/**
+ * @brief Polymorphic memory resource over the heap, for std::pmr
+ * containers.
+ */
+class memory_resource : public std::pmr::memory_resource {
+  protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        return detail::allocate_bytes(bytes, alignment);
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes,
+                       std::size_t alignment) override {
+        detail::deallocate_bytes(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(
+        const std::pmr::memory_resource &other) const noexcept override {
+        return dynamic_cast<const memory_resource *>(&other) != nullptr;
+    }
+};
+
+/**
+ * @brief The process-wide heap resource, in the style of
+ * std::pmr::new_delete_resource().
+ */
+inline memory_resource *get_memory_resource() noexcept {
+    static memory_resource resource;
+    return &resource;
+}
+
+/**
+ * @brief Stateless allocator for standard containers, e.g.
+ * std::vector<int, heap_engine::allocator<int>>.
+ */
+template <class T> class allocator {
+  public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+
+    allocator() noexcept = default;
+
+    template <class U> allocator(const allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T *>(
+            detail::allocate_bytes(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        detail::deallocate_bytes(ptr, n * sizeof(T), alignof(T));
+    }
+};
+
+template <class T, class U>
+bool operator==(const allocator<T> &, const allocator<U> &) noexcept {
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const allocator<T> &, const allocator<U> &) noexcept {
+    return false;
+}
+
+} // namespace heap_engine
+
+#endif // HEAP_ENGINE_HPP
@@ -24,6 +24,8 @@
 #define HEAP_BACKEND_STATIC 1
 #define HEAP_BACKEND_SBRK 2
 #define HEAP_BACKEND_MMAP 3
+#define HEAP_BACKEND_FILE 4 ///< Persistent heap in a memory-mapped file
+#define HEAP_BACKEND_SHM 5  ///< Heap shared between processes (shm_open)
 
 // Default to static heap for embedded builds
 #ifndef HEAP_BACKEND
@@ -36,14 +38,389 @@
 #elif HEAP_BACKEND == HEAP_BACKEND_MMAP
 #include <sys/mman.h> // For mmap()
 #include <unistd.h>
+#elif HEAP_BACKEND == HEAP_BACKEND_FILE
+#ifndef HEAP_FILE_PATH
+#define HEAP_FILE_PATH "heapengine.heap" ///< File formatted by allocator_init
 #endif
+#elif HEAP_BACKEND == HEAP_BACKEND_SHM
+#ifndef HEAP_SHM_NAME
+#define HEAP_SHM_NAME "/heapengine" ///< Segment formatted by allocator_init
+#endif
+#endif
+
+// Backends whose heap is a mapping addressed by offsets.
+#define HEAP_MAPPED_BACKEND                                                    \
+    (HEAP_BACKEND == HEAP_BACKEND_FILE || HEAP_BACKEND == HEAP_BACKEND_SHM)
 // --- END V2.0 HEAP BACKEND CONFIGURATION ---
 
+// --- Threading and NUMA ---
+
+// Per-arena mutexes around the free lists (hosted builds with pthreads).
+#ifndef HEAP_THREAD_SAFE
+#define HEAP_THREAD_SAFE 0
+#endif
+
+// One heap per NUMA node, each bound to its node (MMAP backend only).
+#ifndef HEAP_NUMA
+#define HEAP_NUMA 0
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_SHM && !HEAP_THREAD_SAFE
+#error "HEAP_BACKEND_SHM requires HEAP_THREAD_SAFE"
+#endif
+
+#if HEAP_NUMA
+#if HEAP_BACKEND != HEAP_BACKEND_MMAP || !HEAP_THREAD_SAFE
+#error "HEAP_NUMA requires the MMAP backend and HEAP_THREAD_SAFE"
+#endif
+#ifndef HEAP_NUMA_MAX_NODES
+// Heaps mapped at most. Nodes past the last heap wrap round-robin: node n
+// allocates from heap n modulo the number of heaps.
+#define HEAP_NUMA_MAX_NODES 8
+#endif
+#ifndef HEAP_NUMA_NODES
+#define HEAP_NUMA_NODES 0 ///< Node count override; 0 detects from sysfs.
+#endif
+#ifndef HEAP_NUMA_REFRESH
+#define HEAP_NUMA_REFRESH 1024 ///< Allocations between node lookups.
+#endif
+#endif
+
+// --- Memory Regions ---
+
+// Several static regions (e.g. TCM plus external RAM), each its own arena.
+#ifndef HEAP_REGIONS
+#define HEAP_REGIONS 0
+#endif
+
+#if HEAP_REGIONS
+#if HEAP_BACKEND != HEAP_BACKEND_STATIC
+#error "HEAP_REGIONS requires the STATIC backend"
+#endif
+#ifndef HEAP_MAX_REGIONS
+#define HEAP_MAX_REGIONS 4 ///< Regions allocator_init_regions() accepts.
+#endif
+#ifndef HEAP_REGION_SMALL_MAX
+/** @brief Requests up to this many bytes prefer HEAP_REGION_FAST regions. */
+#define HEAP_REGION_SMALL_MAX 256
+#endif
+#define HEAP_REGION_FAST 0x01u ///< Fast memory, e.g. TCM or on-chip SRAM.
+#define HEAP_REGION_DMA 0x02u  ///< Memory DMA controllers can reach.
+#endif
+
+// --- Hardened Debug Mode ---
+
+// Sampled guard-page allocations and trailing canaries (hosted builds only).
+#ifndef HEAP_DEBUG_GUARD
+#define HEAP_DEBUG_GUARD 0
+#endif
+
+#if HEAP_DEBUG_GUARD
+// Guarded buffers are mapped privately, outside the file or segment.
+#if HEAP_MAPPED_BACKEND
+#error "HEAP_DEBUG_GUARD cannot be used with mapped backends"
+#endif
+#ifndef HEAP_GUARD_SAMPLE_RATE
+#define HEAP_GUARD_SAMPLE_RATE 1000 ///< Default: guard 1 in N allocations.
+#endif
+#ifndef HEAP_GUARD_SLOTS
+#define HEAP_GUARD_SLOTS 64 ///< Guarded allocations live at the same time.
+#endif
+#define HEAP_CANARY_BYTE 0xCA ///< Fill byte of trailing canaries.
+#define MY_ALLOC_CANARY_SIZE ALIGNMENT ///< Canary bytes after each request.
+#else
+#define MY_ALLOC_CANARY_SIZE 0
+#endif
+
+// --- Heap Checkpoints ---
+
+// Undo journal of free-list metadata for allocator_checkpoint()/rollback().
+#ifndef HEAP_CHECKPOINT
+#define HEAP_CHECKPOINT 0
+#endif
+
+#if HEAP_CHECKPOINT
+#if HEAP_NUMA || HEAP_REGIONS
+#error "HEAP_CHECKPOINT supports a single arena only"
+#endif
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+#error "HEAP_CHECKPOINT cannot roll back other processes' allocations"
+#endif
+// A few entries per minimum-size block (about 56 bytes on 64-bit), enough
+// to undo filling the heap; a malloc and free pair takes about six.
+#ifndef HEAP_JOURNAL_CAPACITY
+#define HEAP_JOURNAL_CAPACITY (HEAP_SIZE / 16 + 64) ///< Undoable writes.
+#endif
+#endif
+
+// --- Relocatable Handles ---
+
+// Handle API whose unlocked blocks allocator_compact() may move.
+#ifndef HEAP_HANDLES
+#define HEAP_HANDLES 0
+#endif
+
+#if HEAP_HANDLES
+#if HEAP_MAPPED_BACKEND
+#error "HEAP_HANDLES needs a process-private heap"
+#endif
+#ifndef HEAP_HANDLE_SLOTS
+#define HEAP_HANDLE_SLOTS 64 ///< Handles that can be live at once.
+#endif
+#endif
+
+// --- Free-Block Index ---
+
+// SIMD-searchable summary of each arena's free list.
+#ifndef HEAP_FREE_INDEX
+#define HEAP_FREE_INDEX 0
+#endif
+
+#if HEAP_FREE_INDEX
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+#error "HEAP_FREE_INDEX cannot track other processes' frees"
+#endif
+#ifndef HEAP_FREE_INDEX_CAPACITY
+/** @brief Free blocks indexed per arena; beyond this searches walk the list. */
+#define HEAP_FREE_INDEX_CAPACITY (HEAP_SIZE / 256 + 16)
+#endif
+#endif
+
+// --- Allocation Policy ---
+
+#define HEAP_POLICY_FIRST_FIT 1 ///< Explicit free list, first fit
+#define HEAP_POLICY_TLSF 2      ///< Two-Level Segregated Fit, O(1)
+#define HEAP_POLICY_BUDDY 3     ///< Binary buddy system, power-of-two blocks
+
+#ifndef HEAP_POLICY
+#define HEAP_POLICY HEAP_POLICY_FIRST_FIT
+#endif
+
+#if HEAP_POLICY != HEAP_POLICY_FIRST_FIT
+#if HEAP_MAPPED_BACKEND
+#error "Only HEAP_POLICY_FIRST_FIT supports mapped backends"
+#endif
+// These work on the first-fit free list.
+#if HEAP_CHECKPOINT || HEAP_HANDLES || HEAP_FREE_INDEX
+#error "Checkpoints, handles and the free index need HEAP_POLICY_FIRST_FIT"
+#endif
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+#ifndef HEAP_TLSF_FL_COUNT
+/** @brief First-level size classes; blocks up to 2^(FL_COUNT + 6) bytes. */
+#define HEAP_TLSF_FL_COUNT 26
+#endif
+#if HEAP_TLSF_FL_COUNT > 32
+#error "HEAP_TLSF_FL_COUNT must fit the 32-bit first-level bitmap"
+#endif
+/** @brief Most steps (bitmap words searched, free-list updates and merges)
+ * a TLSF malloc or free takes, whatever the state of the heap. */
+#define HEAP_TLSF_MAX_STEPS 5
+#endif
+
+// --- Sampling Heap Profiler ---
+
+// Backtraces of sampled allocations (hosted builds with execinfo.h only).
+#ifndef HEAP_PROFILER
+#define HEAP_PROFILER 0
+#endif
+
+#if HEAP_PROFILER
+#include <stdio.h> // For FILE
+
+#ifndef HEAP_PROFILER_SAMPLE_PERIOD
+#define HEAP_PROFILER_SAMPLE_PERIOD (512 * 1024) ///< Mean bytes per sample.
+#endif
+#ifndef HEAP_PROFILER_MAX_SAMPLES
+#define HEAP_PROFILER_MAX_SAMPLES 1024 ///< Live samples kept at most.
+#endif
+#ifndef HEAP_PROFILER_MAX_DEPTH
+#define HEAP_PROFILER_MAX_DEPTH 32 ///< Frames recorded per sample.
+#endif
+#endif
+
+// --- Latency Histograms ---
+
+// Per-operation latency histograms of my_malloc, my_free and my_realloc.
+#ifndef HEAP_LATENCY
+#define HEAP_LATENCY 0
+#endif
+
+#if HEAP_LATENCY
+#include <stdio.h> // For FILE
+
+#ifndef HEAP_LATENCY_TSC
+#if defined(__x86_64__) || defined(__i386__)
+#define HEAP_LATENCY_TSC 1 ///< Time with rdtsc instead of clock_gettime.
+#else
+#define HEAP_LATENCY_TSC 0
+#endif
+#endif
+#ifndef HEAP_LATENCY_SUB_BITS
+/** @brief Linear sub-buckets per power of two, as a power of two. */
+#define HEAP_LATENCY_SUB_BITS 5
+#endif
+#ifndef HEAP_LATENCY_DUMP_AT_EXIT
+#define HEAP_LATENCY_DUMP_AT_EXIT 0 ///< Dump the histograms to stderr.
+#endif
+#endif
+
+// --- Memory Budgets ---
+
+// Per-tag byte limits, accounted per thread and published in batches.
+#ifndef HEAP_BUDGETS
+#define HEAP_BUDGETS 0
+#endif
+
+#if HEAP_BUDGETS
+#if HEAP_CHECKPOINT || HEAP_BACKEND == HEAP_BACKEND_SHM
+#error "HEAP_BUDGETS cannot account rollbacks or other processes' frees"
+#endif
+#ifndef HEAP_BUDGET_TAGS
+#define HEAP_BUDGET_TAGS 8 ///< Tags allocations can be charged to.
+#endif
+#if HEAP_BUDGET_TAGS > 255
+#error "HEAP_BUDGET_TAGS must fit the 8-bit block tag"
+#endif
+#ifndef HEAP_BUDGET_BATCH
+/** @brief Bytes a thread accounts locally before publishing them; each
+ * thread can overshoot a budget by this much. */
+#define HEAP_BUDGET_BATCH (16 * 1024)
+#endif
+#define HEAP_BUDGET_TOTAL HEAP_BUDGET_TAGS ///< Pseudo-tag for all tags.
+#endif
+
+// --- Background Maintenance ---
+
+// A thread that merges, caches and trims free blocks off the request path.
+#ifndef HEAP_MAINTENANCE
+#define HEAP_MAINTENANCE 0
+#endif
+
+#if HEAP_MAINTENANCE
+#if !HEAP_THREAD_SAFE
+#error "HEAP_MAINTENANCE requires HEAP_THREAD_SAFE"
+#endif
+#if HEAP_POLICY != HEAP_POLICY_FIRST_FIT
+#error "HEAP_MAINTENANCE needs HEAP_POLICY_FIRST_FIT"
+#endif
+// Deferred frees and caches live in one process and are not journaled.
+#if HEAP_CHECKPOINT || HEAP_MAPPED_BACKEND
+#error "HEAP_MAINTENANCE cannot be used with checkpoints or mapped backends"
+#endif
+#ifndef HEAP_MAINTENANCE_BINS
+/** @brief Per-size caches; bin i holds blocks of (i + 1) * ALIGNMENT bytes. */
+#define HEAP_MAINTENANCE_BINS 32
+#endif
+#ifndef HEAP_MAINTENANCE_BIN_DEPTH
+#define HEAP_MAINTENANCE_BIN_DEPTH 16 ///< Blocks kept per cache at most.
+#endif
+#endif
+
+// --- Cache-Line Isolation ---
+
+// Objects of different threads that never share a cache line.
+#ifndef HEAP_ISOLATION
+#define HEAP_ISOLATION 0
+#endif
+
+#if HEAP_ISOLATION
+#if !HEAP_THREAD_SAFE
+#error "HEAP_ISOLATION requires HEAP_THREAD_SAFE"
+#endif
+// Runs are held by threads across checkpoints and processes.
+#if HEAP_CHECKPOINT || HEAP_MAPPED_BACKEND
+#error "HEAP_ISOLATION cannot be used with checkpoints or mapped backends"
+#endif
+#ifndef HEAP_CACHE_LINE
+#define HEAP_CACHE_LINE 64 ///< Cache line size in bytes.
+#endif
+#ifndef HEAP_ISOLATION_RUN_SIZE
+/** @brief Bytes of each per-thread run, a multiple of HEAP_CACHE_LINE. */
+#define HEAP_ISOLATION_RUN_SIZE 1024
+#endif
+#if HEAP_ISOLATION_RUN_SIZE % HEAP_CACHE_LINE != 0 ||                         \
+    HEAP_ISOLATION_RUN_SIZE < 4 * HEAP_CACHE_LINE
+#error "HEAP_ISOLATION_RUN_SIZE must be at least 4 cache lines, in lines"
+#endif
+#endif
+
 // --- Congfiguration Constants ---
 
+#ifndef HEAP_SIZE
 #define HEAP_SIZE (1024 * 10) ///< Total size of the heap in bytes.
-#define ALIGNMENT 8           ///< Alignment for memory blocks.
-#define BLOCK_MAGIC 0xC0FFEE  ///< Magic number for block validation.
+#endif
+#define ALIGNMENT 8          ///< Alignment for memory blocks.
+#define BLOCK_MAGIC 0xC0FFEE ///< Magic number for block validation.
+
+#define BLOCK_FLAG_SAMPLED 0x01  ///< Block is in the heap profile.
+#define BLOCK_FLAG_HANDLE 0x02   ///< Block belongs to a handle.
+#define BLOCK_FLAG_IDLE 0x04     ///< Free block seen by a maintenance pass.
+#define BLOCK_FLAG_RELEASED 0x08 ///< Idle block whose pages were released.
+
+#define BLOCK_NONE SIZE_MAX ///< 'next' offset that ends the free list.
+
+// --- Allocation Hints ---
+
+#ifndef HEAP_HINT_HOT_RESERVE
+/** @brief Bytes left free below the hot run when a long-lived block would
+ * otherwise be placed right under it. */
+#define HEAP_HINT_HOT_RESERVE 1024
+#endif
+
+/**
+ * @brief Expected lifetime and temperature of an allocation.
+ *
+ * Hints only steer placement; every hinted block is freed with my_free().
+ */
+typedef enum {
+    HINT_NONE = 0,        ///< Same placement as my_malloc().
+    HINT_SHORT_LIVED = 1, ///< Freed soon: first fit from the bottom.
+    HINT_LONG_LIVED = 2,  ///< Kept: packed down from the top of the heap.
+    HINT_HOT = 4,         ///< Accessed often: kept in one contiguous run.
+} MyAllocHint;
+
+#if HEAP_REGIONS
+#define HINT_REGION_SHIFT 8 ///< Position of the HINT_REGION() bits.
+
+/**
+ * @brief my_malloc_hint() flag limiting a request to the regions that have
+ * all of the HEAP_REGION_* bits in 'attrs'.
+ */
+#define HINT_REGION(attrs) ((unsigned) (attrs) << HINT_REGION_SHIFT)
+#endif
+
+#if HEAP_ISOLATION
+/**
+ * @brief my_malloc_hint() flag placing the object on cache lines that no
+ * isolated object of another thread uses.
+ */
+#define HINT_ISOLATED 8u
+#endif
+
+// --- Size Classes ---
+
+/** @brief Rounds 'n' up to the next multiple of ALIGNMENT. */
+#define MY_ALLOC_ALIGN_UP(n)                                                   \
+    (((size_t) (n) + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1))
+
+/** @brief Bytes reserved in front of every user pointer for the offset word. */
+#define MY_ALLOC_PREFIX_SIZE MY_ALLOC_ALIGN_UP(sizeof(size_t))
+
+/** @brief Largest request that can be turned into a size class safely. */
+#define MY_ALLOC_MAX_REQUEST                                                   \
+    (SIZE_MAX - MY_ALLOC_PREFIX_SIZE - MY_ALLOC_CANARY_SIZE - ALIGNMENT)
+
+/**
+ * @brief Block data size (size class) used to serve a request of 'n' bytes.
+ *
+ * Every block data area is a multiple of ALIGNMENT, so a block of this size
+ * holds the offset word followed by 'n' aligned user bytes (and the
+ * trailing canary in debug mode).
+ */
+#define MY_ALLOC_SIZE_CLASS(n)                                                 \
+    (MY_ALLOC_PREFIX_SIZE + MY_ALLOC_ALIGN_UP((n) + MY_ALLOC_CANARY_SIZE))
 
 // --- Data Structures ---
 
@@ -53,22 +430,216 @@
  * Each allocated or free block in the heap begins with this header.
  * - size: number of usable bytes in the block (not including header).
  * - is_free: true if the block is currently free.
- * - next: pointer to the next free block in the free list.
+ * - flags: BLOCK_FLAG_* bits of an allocated block (or, with
+ *   maintenance, of a free one).
+ * - next: offset of the next free block from the heap base (BLOCK_NONE
+ *   ends the list), which keeps the heap position-independent.
+ * - tag: (budgets) budget tag the block is charged to.
  * - magic: sentinel value for corruption detection.
+ * - index_pos: (free index) entry of the block in its arena's index.
+ * - prev_free: (TLSF, buddy) back link of the doubly linked free lists,
+ *   for O(1) unlinking.
+ * - prev_phys: (TLSF) the physical neighbour below, for backward
+ *   coalescing.
+ * - requested: (debug mode) bytes requested, locating the trailing canary.
  */
 typedef struct BlockHeader {
     size_t size;              ///< Size of the data area in bytes
     bool is_free;             ///< Whether this block is free
-    struct BlockHeader *next; ///< Next block in the free list
+    uint8_t flags;            ///< BLOCK_FLAG_* bits
+#if HEAP_BUDGETS
+    uint8_t tag; ///< Budget tag charged for the block
+#endif
+    size_t next;              ///< Offset of the next block in the free list
     uint32_t magic;           ///< Magic number for validation
+#if HEAP_FREE_INDEX
+    uint32_t index_pos; ///< Free-index entry of a free block
+#endif
+#if HEAP_POLICY != HEAP_POLICY_FIRST_FIT
+    size_t prev_free; ///< Offset of the previous block in the free list
+#endif
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+    size_t prev_phys; ///< Offset of the block just below in memory
+#endif
+#if HEAP_DEBUG_GUARD
+    size_t requested; ///< Requested size (debug mode only)
+#endif
 } BlockHeader;
 
+#if HEAP_REGIONS
+/**
+ * @brief A memory region passed to allocator_init_regions().
+ */
+typedef struct {
+    void *base;        ///< First byte of the region
+    size_t size;       ///< Size of the region in bytes
+    unsigned priority; ///< Higher priorities are tried first
+    unsigned attrs;    ///< HEAP_REGION_* bits; the others are free to use
+} HeapRegion;
+#endif
+
+#if HEAP_DEBUG_GUARD
+/**
+ * @brief Counters of the hardened debug mode.
+ */
+typedef struct {
+    size_t sampled_allocations; ///< Allocations placed against guard pages
+    size_t guarded_live;        ///< Guarded allocations not yet freed
+    size_t canary_failures;     ///< Overflows caught by trailing canaries
+} HeapGuardStats;
+#endif
+
+#if HEAP_CHECKPOINT
+/**
+ * @brief Handle to a recorded free-structure state.
+ */
+typedef struct {
+    size_t position;     ///< Journal length when the checkpoint was taken
+    uint32_t generation; ///< allocator_init() epoch the checkpoint belongs to
+} HeapCheckpoint;
+#endif
+
+#if HEAP_HANDLES
+/**
+ * @brief Relocatable block: a pointer to its master pointer.
+ *
+ * '*h' is the block's current address. It may change whenever
+ * allocator_compact() runs (which hhandle_alloc() may do), so keep only the
+ * handle and use hlock() to get a stable pointer.
+ */
+typedef void **HHandle;
+#endif
+
+#if HEAP_NUMA
+/**
+ * @brief Placement counters of the NUMA mode.
+ */
+typedef struct {
+    size_t nodes;              ///< Per-node heaps in use
+    size_t local_allocations;  ///< Served from the caller's node
+    size_t remote_allocations; ///< Served from another node (local was full)
+    size_t cross_node_frees;   ///< Freed from a node other than the block's
+    size_t bind_failures;      ///< Heaps the kernel refused to bind
+} HeapNumaStats;
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+/**
+ * @brief Work done by the TLSF policy, over all arenas.
+ */
+typedef struct {
+    size_t max_malloc_steps; ///< Most steps taken by one malloc
+    size_t max_free_steps;   ///< Most steps taken by one free
+} HeapTlsfStats;
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_BUDDY
+/**
+ * @brief Work done by the buddy policy, summed over all arenas.
+ */
+typedef struct {
+    size_t splits;       ///< Blocks halved to serve a request
+    size_t merges;       ///< Buddy pairs joined on free
+    size_t largest_free; ///< Data bytes of the largest free block
+} HeapBuddyStats;
+#endif
+
+#if HEAP_PROFILER
+/**
+ * @brief Counters of the sampling heap profiler.
+ */
+typedef struct {
+    size_t live_samples;    ///< Sampled allocations not yet freed
+    size_t live_bytes;      ///< Requested bytes of those allocations
+    size_t dropped_samples; ///< Samples lost because the table was full
+} HeapProfileStats;
+#endif
+
+#if HEAP_LATENCY
+/**
+ * @brief Operations with a latency histogram.
+ */
+typedef enum {
+    HEAP_OP_MALLOC,  ///< my_malloc(), my_malloc_hint(), my_malloc_class()
+    HEAP_OP_FREE,    ///< my_free(), my_free_sized()
+    HEAP_OP_REALLOC, ///< my_realloc(), including the malloc and free inside
+    HEAP_OP_COUNT
+} HeapOp;
+
+/**
+ * @brief Latency summary of one operation.
+ *
+ * Percentiles are the upper bounds of their histogram buckets, so they
+ * overstate the true value by at most 1 / 2^HEAP_LATENCY_SUB_BITS.
+ */
+typedef struct {
+    uint64_t count;   ///< Calls recorded
+    uint64_t p50_ns;  ///< Median latency
+    uint64_t p90_ns;  ///< 90th percentile
+    uint64_t p99_ns;  ///< 99th percentile
+    uint64_t p999_ns; ///< 99.9th percentile
+    uint64_t max_ns;  ///< Slowest call
+    double mean_walk; ///< Free blocks examined per call (malloc only)
+    double tail_walk; ///< Same, over the calls at or above p99
+} HeapLatencyStats;
+#endif
+
+#if HEAP_BUDGETS
+/**
+ * @brief Why an allocation was refused.
+ */
+typedef enum {
+    HEAP_LIMIT_BUDGET,    ///< It would exceed its tag's or the total budget
+    HEAP_LIMIT_NO_MEMORY ///< No heap block was large enough
+} HeapLimitReason;
+
+/**
+ * @brief A refused allocation, as passed to the limit handler.
+ */
+typedef struct {
+    HeapLimitReason reason;
+    unsigned tag;   ///< Tag charged, or HEAP_BUDGET_TOTAL for the total
+    size_t size;    ///< Block size requested
+    size_t usage;   ///< Bytes charged to 'tag' at the time
+    size_t limit;   ///< Budget of 'tag', or 0 if it has none
+} HeapLimitEvent;
+
+/**
+ * @brief Called before a refused allocation returns NULL.
+ *
+ * Runs on the allocating thread without any heap lock held, so it may free
+ * memory, e.g. to shed cached data before the caller retries.
+ */
+typedef void (*HeapLimitHandler)(const HeapLimitEvent *event, void *ctx);
+#endif
+
+#if HEAP_MAINTENANCE
+/**
+ * @brief Counters of the background maintenance, summed over arenas.
+ */
+typedef struct {
+    size_t passes;         ///< Maintenance passes over an arena
+    size_t merges;         ///< Free blocks merged into the block below
+    size_t deferred_frees; ///< Frees left for the next pass to merge
+    size_t cache_hits;     ///< Allocations served from a per-size cache
+    size_t cache_misses;   ///< Cacheable allocations that found it empty
+    size_t cache_refills;  ///< Blocks carved into the caches by passes
+    size_t released_bytes; ///< Bytes of idle free blocks returned to the OS
+} HeapMaintenanceStats;
+#endif
+
 // --- Function Prototypes ---
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
  * @brief Initializes the memory allocator.
  * Must be called once before any other allocator functions are used.
- * Sets up the initial free block covering the entire heap.
+ * Sets up the initial free block covering the entire heap. With the SHM
+ * backend, it attaches to an existing HEAP_SHM_NAME segment as
+ * allocator_open_shared() does, leaving its blocks in place.
  */
 void allocator_init(void);
 
@@ -109,10 +680,484 @@ void *my_calloc(size_t nmemb, size_t size);
  */
 void *my_realloc(void *ptr, size_t new_size);
 
+/**
+ * @brief Allocates a block of an already computed size class.
+ *
+ * Fast path behind my_malloc(): skips the zero/overflow checks and the
+ * size-class arithmetic. 'class_size' must come from MY_ALLOC_SIZE_CLASS().
+ *
+ * @param class_size Block data size, as returned by MY_ALLOC_SIZE_CLASS().
+ * @return A pointer to the allocated memory, or NULL if the request fails.
+ */
+void *my_malloc_class(size_t class_size);
+
+/**
+ * @brief Allocates 'size' bytes, placed according to 'hints'.
+ *
+ * Short-lived and unhinted blocks are taken first-fit from the bottom of
+ * the heap. Long-lived blocks are carved from the highest free block that
+ * fits, so they do not pin fragments among short-lived churn. Hot blocks
+ * are carved directly below the previous hot block, so they share cache
+ * lines and pages. HINT_HOT takes precedence when combined with another
+ * hint.
+ *
+ * @param size Number of bytes to allocate.
+ * @param hints Bitwise OR of MyAllocHint values.
+ * @return A pointer to the allocated memory, or NULL if the request fails.
+ */
+void *my_malloc_hint(size_t size, unsigned hints);
+
+/**
+ * @brief Frees a block whose requested size is known to the caller.
+ *
+ * The header is located directly from the user pointer instead of through
+ * the stored offset, and 'size' is checked against the block size.
+ * Pointers from my_malloc_aligned() or isolated allocations, whose offset
+ * word shows they were moved, are freed as by my_free() instead.
+ *
+ * @param ptr A pointer to the memory block to be freed.
+ * @param size The size originally requested for the block.
+ */
+void my_free_sized(void *ptr, size_t size);
+
+/**
+ * @brief Returns how many bytes the caller may use at 'ptr'.
+ *
+ * Derived from the block header: the requested size plus whatever slack
+ * size-class rounding and splitting left in the block. Writing up to that
+ * many bytes is valid, and my_realloc() within it keeps the block in place.
+ * In debug mode the canary follows the requested size, so only that is
+ * reported.
+ *
+ * @param ptr A pointer returned by the allocator, or NULL.
+ * @return Usable bytes, or 0 for NULL or an invalid pointer.
+ */
+size_t my_malloc_usable_size(const void *ptr);
+
+/**
+ * @brief Allocates at least 'size' bytes and reports the real capacity.
+ *
+ * Lets containers grow into the slack of their block without calling
+ * my_realloc(). Either 'size' or '*actual' may be passed to my_free_sized().
+ *
+ * @param size Minimum number of bytes to allocate.
+ * @param actual Set to the usable bytes at the returned pointer (0 on
+ * failure); may be NULL.
+ * @return A pointer to the allocated memory, or NULL if the request fails.
+ */
+void *my_malloc_at_least(size_t size, size_t *actual);
+
+/**
+ * @brief Allocates 'size' bytes whose address is a multiple of 'alignment'.
+ *
+ * Alignments up to ALIGNMENT are served by my_malloc(). Larger ones pad the
+ * block and are never placed against guard pages in debug mode. Free the
+ * result with my_free() or my_free_sized(). my_realloc() keeps the
+ * alignment only while it resizes in place.
+ *
+ * @param alignment A power of two.
+ * @param size Number of bytes to allocate.
+ * @return A pointer to the allocated memory, or NULL if 'alignment' is not
+ * a power of two or the request fails.
+ */
+void *my_malloc_aligned(size_t alignment, size_t size);
+
+#if HEAP_DEBUG_GUARD
+/**
+ * @brief Sets how often allocations are placed against guard pages.
+ *
+ * @param rate Guard one allocation in every 'rate'; 0 disables sampling.
+ */
+void allocator_set_guard_sample_rate(size_t rate);
+
+/**
+ * @brief Copies the debug-mode counters into 'out'.
+ */
+void allocator_get_guard_stats(HeapGuardStats *out);
+#endif
+
+#if HEAP_PROFILER
+/**
+ * @brief Sets the mean number of allocated bytes between two samples.
+ *
+ * @param bytes Sample period in bytes; 0 or 1 samples every allocation.
+ */
+void allocator_set_profile_sample_period(size_t bytes);
+
+/**
+ * @brief Copies the profiler counters into 'out'.
+ */
+void allocator_get_profile_stats(HeapProfileStats *out);
+
+/**
+ * @brief Writes the live sampled allocations, grouped by call stack.
+ *
+ * The output uses the legacy pprof heap format ("heap_v2") followed by the
+ * process mappings, so it can be read with `pprof <binary> <file>`.
+ *
+ * @param out Stream to write to.
+ * @return 0 on success, -1 on error.
+ */
+int allocator_dump_profile(FILE *out);
+#endif
+
+#if HEAP_LATENCY
+/**
+ * @brief Summarizes the latency histogram of 'op' into 'out'.
+ */
+void allocator_get_latency_stats(HeapOp op, HeapLatencyStats *out);
+
+/**
+ * @brief Clears all latency histograms (allocator_init() does too).
+ */
+void allocator_reset_latency(void);
+
+/**
+ * @brief Writes every latency histogram, one line per non-empty bucket.
+ *
+ * Malloc buckets also show the mean number of free blocks examined, which
+ * ties slow calls to long free-list walks.
+ *
+ * @param out Stream to write to.
+ * @return 0 on success, -1 on error.
+ */
+int allocator_dump_latency(FILE *out);
+#endif
+
+#if HEAP_BUDGETS
+/**
+ * @brief Limits the bytes charged to 'tag' (or to all tags together, with
+ * HEAP_BUDGET_TOTAL); 0 removes the limit.
+ *
+ * Usage is summed from per-thread batches, so each thread can exceed a
+ * budget by up to HEAP_BUDGET_BATCH bytes before it is refused. Budgets
+ * are kept across allocator_init(); usage is not.
+ */
+void allocator_set_budget(unsigned tag, size_t limit);
+
+/**
+ * @brief Bytes of heap blocks charged to 'tag' (or HEAP_BUDGET_TOTAL).
+ *
+ * Includes every batch published so far and the calling thread's own.
+ */
+size_t allocator_get_budget_usage(unsigned tag);
+
+/**
+ * @brief Charges the calling thread's later allocations to 'tag'.
+ *
+ * Blocks stay charged to the tag they were allocated under, whichever
+ * thread frees them. Tags outside [0, HEAP_BUDGET_TAGS) are ignored.
+ *
+ * @return The thread's previous tag (0 initially).
+ */
+unsigned allocator_set_thread_tag(unsigned tag);
+
+/**
+ * @brief Installs the handler called when an allocation is refused; NULL
+ * removes it. Set it before other threads allocate.
+ */
+void allocator_set_limit_handler(HeapLimitHandler handler, void *ctx);
+#endif
+
+#if HEAP_REGIONS
+/**
+ * @brief Initializes the allocator over 'count' memory regions instead of
+ * the static heap array; allocator_init() goes back to the array.
+ *
+ * Each region becomes an arena. Requests of up to HEAP_REGION_SMALL_MAX
+ * bytes and HINT_HOT requests try the HEAP_REGION_FAST regions first;
+ * larger ones leave those for last. Within each group, regions are tried
+ * by descending priority, then in array order. HINT_REGION() restricts a
+ * request to regions with given attributes.
+ *
+ * @param regions Regions to use. They must not overlap and must stay
+ * valid until the next allocator_init*() or allocator_destroy().
+ * @param count Number of regions, at most HEAP_MAX_REGIONS.
+ * @return 0 on success, -1 if 'count' is out of range or a region is too
+ * small or overlaps another; the allocator is then left empty.
+ */
+int allocator_init_regions(const HeapRegion *regions, size_t count);
+
+/**
+ * @brief Index in the allocator_init_regions() array of the region holding
+ * 'ptr' (0 after allocator_init()), or -1 if no region holds it.
+ */
+int allocator_region_of(const void *ptr);
+#endif
+
+#if HEAP_MAINTENANCE
+/**
+ * @brief Starts the maintenance thread, which runs a pass every
+ * 'interval_ms' milliseconds.
+ *
+ * While it runs, my_free() only marks a block free or pushes it on the
+ * cache for its size, and my_malloc() pops cached blocks; merging is left
+ * to the passes.
+ *
+ * Worst case: a malloc that finds no fit while blocks freed since the last
+ * pass are unmerged wakes the thread and waits for a pass before retrying.
+ * A pass walks every block of every arena under the arena lock, so that
+ * malloc, and any other call on a locked arena meanwhile, can wait time
+ * proportional to the number of blocks. A heap that stays full pays this
+ * once per batch of frees, not on every failed malloc.
+ *
+ * @return 0 on success, -1 if the thread is already running or cannot be
+ * created.
+ */
+int allocator_start_maintenance(unsigned interval_ms);
+
+/**
+ * @brief Stops the maintenance thread and merges every deferred and cached
+ * block back into the free list. Does nothing if it is not running.
+ *
+ * allocator_init() and allocator_destroy() stop it too.
+ */
+void allocator_stop_maintenance(void);
+
+/**
+ * @brief Runs one maintenance pass over every arena now.
+ *
+ * Merges all adjacent free blocks, refills the caches that were asked for
+ * blocks since the last pass, and (MMAP backend) returns the pages of free
+ * blocks that stayed idle for a whole pass to the OS.
+ */
+void allocator_run_maintenance(void);
+
+/**
+ * @brief Copies the maintenance counters into 'out'.
+ */
+void allocator_get_maintenance_stats(HeapMaintenanceStats *out);
+#endif
+
+#if HEAP_ISOLATION
+/**
+ * @brief Makes every my_malloc(), my_calloc(), my_realloc() and
+ * my_malloc_hint() call of the current thread behave as if HINT_ISOLATED
+ * were given.
+ *
+ * Isolated objects of up to a quarter of HEAP_ISOLATION_RUN_SIZE are packed
+ * into a run owned by the allocating thread; larger ones get whole lines
+ * of their own. Any thread may free them. They carry no debug canary, and
+ * my_malloc_at_least() reports no slack for them. my_malloc_class() and
+ * my_malloc_aligned() are not affected.
+ *
+ * @return Whether the mode was enabled before.
+ */
+bool allocator_set_thread_isolation(bool enabled);
+#endif
+
+#if HEAP_CHECKPOINT
+/**
+ * @brief Records the heap's free-structure state (not its data).
+ *
+ * Checkpoints nest, and each one must be finished by a rollback or a
+ * commit. Until all of them are, every metadata write is journaled (up to
+ * HEAP_JOURNAL_CAPACITY entries, a few per allocation or free).
+ *
+ * @return Handle to pass to allocator_rollback() or allocator_commit().
+ */
+HeapCheckpoint allocator_checkpoint(void);
+
+/**
+ * @brief Returns the heap to the state recorded by 'cp'.
+ *
+ * Every block allocated since 'cp' becomes free again and every block freed
+ * since 'cp' becomes allocated again, in time proportional to the work done
+ * since the checkpoint. Guarded and profiled bookkeeping is not rolled back.
+ *
+ * @param cp Checkpoint to restore.
+ * @return true on success, false if 'cp' is stale (allocator_init() ran) or
+ * the journal overflowed. A checkpoint that fails to roll back stays open;
+ * commit it or re-run allocator_init().
+ */
+bool allocator_rollback(HeapCheckpoint cp);
+
+/**
+ * @brief Keeps all changes made since 'cp' and, once no checkpoint is
+ * open, stops journaling.
+ */
+void allocator_commit(HeapCheckpoint cp);
+#endif
+
+#if HEAP_HANDLES
+/**
+ * @brief Allocates a relocatable block of 'size' bytes.
+ *
+ * If the heap is too fragmented, compacts it once and retries.
+ *
+ * @return The handle, or NULL if the request fails or no handle is free.
+ */
+HHandle hhandle_alloc(size_t size);
+
+/**
+ * @brief Frees a handle and its block. The handle may be locked.
+ */
+void hhandle_free(HHandle h);
+
+/**
+ * @brief Pins the block of 'h' and returns its address.
+ *
+ * The block is not moved until a matching hunlock(). Locks nest.
+ *
+ * @return The block's address, or NULL for an invalid handle.
+ */
+void *hlock(HHandle h);
+
+/**
+ * @brief Releases one hlock() of 'h'.
+ */
+void hunlock(HHandle h);
+
+/**
+ * @brief Slides unlocked handle blocks together and merges the free space.
+ *
+ * Blocks from my_malloc(), locked handles and profiled blocks stay where
+ * they are; free space can only merge between them. An active checkpoint
+ * cannot be rolled back past a compaction.
+ *
+ * @return Size of the largest free block afterwards, in bytes.
+ */
+size_t allocator_compact(void);
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+/**
+ * @brief Copies the TLSF step counters (reset by allocator_init()) into
+ * 'out'.
+ */
+void allocator_get_tlsf_stats(HeapTlsfStats *out);
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_BUDDY
+/**
+ * @brief Copies the buddy counters (reset by allocator_init()) into 'out'.
+ */
+void allocator_get_buddy_stats(HeapBuddyStats *out);
+#endif
+
+#if HEAP_FREE_INDEX
+/**
+ * @brief Turns the free-block index on or off at run time.
+ *
+ * Placement is the same either way; only the search changes, which makes
+ * the two easy to compare. A re-enabled index is rebuilt on next use.
+ */
+void allocator_set_free_index(bool enabled);
+#endif
+
+#if HEAP_NUMA
+/**
+ * @brief Copies the NUMA placement counters into 'out'.
+ */
+void allocator_get_numa_stats(HeapNumaStats *out);
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_FILE
+/**
+ * @brief Maps the heap stored in 'path', creating it if it does not exist.
+ *
+ * An existing heap is resumed exactly as it was left: its blocks, free list
+ * and root survive, although the file may now be mapped at a different
+ * address. Use allocator_init() instead to start over with an empty heap.
+ *
+ * @param path Heap file to open or create.
+ * @param size Heap size in bytes for a new file (ignored when resuming).
+ * @return 0 on success, -1 if the file cannot be mapped or was written by
+ * an incompatible build.
+ */
+int allocator_open_file(const char *path, size_t size);
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+/**
+ * @brief Attaches to the shared heap 'name', creating it if needed.
+ *
+ * The first process to open 'name' formats the segment; later ones attach
+ * to it as is, at whatever address their mapping gets. All of them share
+ * one process-shared lock, so a block allocated by one process can be
+ * handed over as an offset (allocator_ptr_to_offset()) and freed by another.
+ *
+ * @param name POSIX shared memory name, e.g. "/pipeline".
+ * @param size Heap size in bytes if the segment is created.
+ * @return 0 on success, -1 on error.
+ */
+int allocator_open_shared(const char *name, size_t size);
+
+/**
+ * @brief Removes the shared heap 'name'. Processes still attached keep
+ * their mapping until allocator_destroy().
+ *
+ * @return 0 on success, -1 on error.
+ */
+int allocator_unlink_shared(const char *name);
+#endif
+
+#if HEAP_MAPPED_BACKEND
+/**
+ * @brief Flushes the heap to its file (a no-op for shared memory).
+ *
+ * @return 0 on success, -1 on error.
+ */
+int allocator_sync(void);
+
+/**
+ * @brief Stores 'ptr' (or NULL) as the heap's root object.
+ *
+ * The root is how a later run finds its data again after reopening.
+ */
+void allocator_set_root(void *ptr);
+
+/**
+ * @brief Returns the root object at its current address, or NULL.
+ */
+void *allocator_get_root(void);
+
+/**
+ * @brief Converts a heap pointer to an offset that stays valid if the heap
+ * is mapped elsewhere. Store offsets, not pointers, inside the heap.
+ *
+ * @return The offset, or BLOCK_NONE if 'ptr' is NULL or outside the heap.
+ */
+size_t allocator_ptr_to_offset(const void *ptr);
+
+/**
+ * @brief Converts an offset from allocator_ptr_to_offset() back to a pointer.
+ *
+ * @return The pointer, or NULL for BLOCK_NONE or an out-of-range offset.
+ */
+void *allocator_offset_to_ptr(size_t offset);
+#endif
+
 /**
  * @brief (V2.0) Cleans up the allocator, unmapping memory if necessary.
  *
+ * The FILE backend flushes the heap to its file first. The SHM backend
+ * only detaches; the segment stays until allocator_unlink_shared().
  */
 void allocator_destroy(void);
 
+#ifdef __cplusplus
+}
+#endif
+
+// --- Compile-Time Size-Class Dispatch ---
+
+/*
+ * When the size passed to my_malloc() is a compile-time constant (the common
+ * my_malloc(sizeof(Node)) case), resolve its size class at compile time and
+ * call the fast path directly. Non-constant sizes go to the real function.
+ * The single unsigned compare rejects both 0 and oversized requests.
+ * Define MY_ALLOC_NO_CONST_DISPATCH to disable. Debug mode needs the real
+ * requested size for its canary and sampling, and isolation mode checks the
+ * thread's mode, so both always call my_malloc.
+ */
+#if defined(__GNUC__) && !defined(MY_ALLOC_NO_CONST_DISPATCH) &&               \
+    !HEAP_DEBUG_GUARD && !HEAP_ISOLATION
+#define my_malloc(size)                                                        \
+    ((__builtin_constant_p(size) &&                                            \
+      (size_t) (size) - 1 < MY_ALLOC_MAX_REQUEST)                              \
+         ? my_malloc_class(MY_ALLOC_SIZE_CLASS(size))                          \
+         : (my_malloc)(size))
+#endif
+
 #endif // MY_ALLOCATOR_H
\ No newline at end of file
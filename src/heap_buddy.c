@@ -0,0 +1,150 @@
+/**
+ * @file heap_buddy.c
+ * @brief Binary buddy system: O(log n) split and merge.
+ *
+ * The order of a block is log2 of its total size, header included. The
+ * header's 'size' keeps the data size, as under the other policies, so the
+ * order is recovered from it. Free blocks of one order form a doubly linked
+ * list, so a buddy can be unlinked without a search.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_buddy.h"
+
+/** @brief Smallest order whose blocks hold a header and ALIGNMENT bytes. */
+#define MIN_ORDER                                                              \
+    (64 - (unsigned) __builtin_clzll(sizeof(BlockHeader) + ALIGNMENT - 1))
+
+static BlockHeader *block_at(char *base, size_t offset) {
+    return offset == BLOCK_NONE ? NULL : (BlockHeader *) (base + offset);
+}
+
+static size_t offset_of(const char *base, const BlockHeader *block) {
+    return (size_t) ((const char *) block - base);
+}
+
+static unsigned order_of(const BlockHeader *block) {
+    return 63 - (unsigned) __builtin_clzll(block->size + sizeof(BlockHeader));
+}
+
+static void insert_free(BuddyControl *buddy, char *base, BlockHeader *block,
+                        unsigned order) {
+    BlockHeader *head = block_at(base, buddy->heads[order]);
+    block->size = ((size_t) 1 << order) - sizeof(BlockHeader);
+    block->is_free = true;
+    block->flags = 0;
+    block->magic = BLOCK_MAGIC;
+    block->next = buddy->heads[order];
+    block->prev_free = BLOCK_NONE;
+    if (head != NULL) {
+        head->prev_free = offset_of(base, block);
+    }
+    buddy->heads[order] = offset_of(base, block);
+    buddy->bitmap |= (uint64_t) 1 << order;
+}
+
+static void remove_free(BuddyControl *buddy, char *base, BlockHeader *block,
+                        unsigned order) {
+    BlockHeader *prev = block_at(base, block->prev_free);
+    BlockHeader *next = block_at(base, block->next);
+    if (next != NULL) {
+        next->prev_free = block->prev_free;
+    }
+    if (prev != NULL) {
+        prev->next = block->next;
+    } else {
+        buddy->heads[order] = block->next;
+        if (block->next == BLOCK_NONE) {
+            buddy->bitmap &= ~((uint64_t) 1 << order);
+        }
+    }
+    block->is_free = false;
+    block->next = BLOCK_NONE;
+    block->prev_free = BLOCK_NONE;
+}
+
+void buddy_reset(BuddyControl *buddy, char *base, size_t size) {
+    buddy->bitmap = 0;
+    for (size_t order = 0; order < BUDDY_ORDERS; order++) {
+        buddy->heads[order] = BLOCK_NONE;
+    }
+    buddy->splits = 0;
+    buddy->merges = 0;
+
+    if (base == NULL) {
+        return;
+    }
+
+    // Largest power of two that fits first, so each top block is aligned
+    // to its own size.
+    size_t offset = 0;
+    while (size - offset >= (size_t) 1 << MIN_ORDER) {
+        unsigned order = 63 - (unsigned) __builtin_clzll(size - offset);
+        insert_free(buddy, base, (BlockHeader *) (base + offset), order);
+        offset += (size_t) 1 << order;
+    }
+}
+
+BlockHeader *buddy_malloc(BuddyControl *buddy, char *base, size_t arena_size,
+                          size_t size) {
+    (void) arena_size;
+    if (size > SIZE_MAX / 2 - sizeof(BlockHeader)) {
+        return NULL;
+    }
+    unsigned want =
+        64 - (unsigned) __builtin_clzll(size + sizeof(BlockHeader) - 1);
+    if (want < MIN_ORDER) {
+        want = MIN_ORDER;
+    }
+
+    uint64_t fits = buddy->bitmap & (~(uint64_t) 0 << want);
+    if (want >= BUDDY_ORDERS || fits == 0) {
+        return NULL;
+    }
+    unsigned order = (unsigned) __builtin_ctzll(fits);
+    BlockHeader *block = block_at(base, buddy->heads[order]);
+    remove_free(buddy, base, block, order);
+
+    // Keep the lower half, free the upper one.
+    while (order > want) {
+        order--;
+        insert_free(buddy, base,
+                    (BlockHeader *) ((char *) block + ((size_t) 1 << order)),
+                    order);
+        buddy->splits++;
+    }
+    block->size = ((size_t) 1 << order) - sizeof(BlockHeader);
+    return block;
+}
+
+void buddy_free(BuddyControl *buddy, char *base, size_t arena_size,
+                BlockHeader *block) {
+    unsigned order = order_of(block);
+    // Headers absorbed by a merge stay marked free, so a second free of
+    // their pointers is still reported.
+    block->is_free = true;
+
+    size_t offset = offset_of(base, block);
+    while (order + 1 < BUDDY_ORDERS) {
+        size_t buddy_offset = offset ^ ((size_t) 1 << order);
+        if (buddy_offset + ((size_t) 1 << order) > arena_size) {
+            break;
+        }
+        BlockHeader *mate = (BlockHeader *) (base + buddy_offset);
+        // A buddy that is split or in use has a smaller order or is taken.
+        if (!mate->is_free || order_of(mate) != order) {
+            break;
+        }
+        remove_free(buddy, base, mate, order);
+        mate->is_free = true;
+        buddy->merges++;
+        if (buddy_offset < offset) {
+            offset = buddy_offset;
+        }
+        order++;
+    }
+
+    insert_free(buddy, base, (BlockHeader *) (base + offset), order);
+}
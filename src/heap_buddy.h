@@ -0,0 +1,58 @@
+/**
+ * @file heap_buddy.h
+ * @brief Internal interface of the binary buddy policy.
+ *
+ * Only built when HEAP_POLICY is HEAP_POLICY_BUDDY. Every block, header
+ * included, spans a power of two bytes and starts at a multiple of its size
+ * from the arena base. Splitting halves a block; a freed block merges with
+ * its buddy, found by flipping one bit of its offset, for as long as the
+ * buddy is free and whole. An arena that is not a power of two is cut into
+ * descending power-of-two top blocks that never merge with each other.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_BUDDY_H
+#define HEAP_BUDDY_H
+
+#include "my_allocator.h"
+
+#define BUDDY_ORDERS 64 ///< One free list per possible block size
+
+/**
+ * @brief Per-order free lists of one arena.
+ */
+typedef struct {
+    uint64_t bitmap; ///< Orders with a non-empty free list
+    /** @brief Offset of the first free block of each order, or BLOCK_NONE. */
+    size_t heads[BUDDY_ORDERS];
+    size_t splits; ///< Blocks halved since the last reset
+    size_t merges; ///< Buddy pairs joined since the last reset
+} BuddyControl;
+
+/**
+ * @brief Cuts 'size' bytes at 'base' into free top blocks.
+ *
+ * With no usable region, leaves every list empty.
+ */
+void buddy_reset(BuddyControl *buddy, char *base, size_t size);
+
+/**
+ * @brief Takes a block of at least 'size' data bytes out of the free lists,
+ * halving a larger block as often as needed.
+ *
+ * @param base First byte of the arena.
+ * @param arena_size Size of the arena in bytes.
+ * @return The allocated block, or NULL if no block is large enough.
+ */
+BlockHeader *buddy_malloc(BuddyControl *buddy, char *base, size_t arena_size,
+                          size_t size);
+
+/**
+ * @brief Returns an allocated block, merging it with free buddies.
+ */
+void buddy_free(BuddyControl *buddy, char *base, size_t arena_size,
+                BlockHeader *block);
+
+#endif // HEAP_BUDDY_H
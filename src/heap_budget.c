@@ -0,0 +1,173 @@
+/**
+ * @file heap_budget.c
+ * @brief Per-tag memory budgets with batched per-thread accounting.
+ *
+ * The shared counters are signed: a block allocated by one thread and freed
+ * by another can be subtracted before it was ever added, so a counter may
+ * briefly dip below zero. Reads clamp it to zero.
+ *
+ * With HEAP_THREAD_SAFE, a thread's pending balances are published when it
+ * exits, through a pthread key destructor.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_budget.h"
+
+#if HEAP_THREAD_SAFE
+#include <pthread.h>
+#endif
+
+_Thread_local unsigned budget_tag = 0;
+_Thread_local int64_t budget_pending[HEAP_BUDGET_TAGS];
+_Thread_local unsigned budget_seen_epoch = 0;
+// Starts ahead of budget_seen_epoch, so every thread joins on first use.
+atomic_uint budget_epoch = 1;
+atomic_bool budget_limited = false;
+
+/** @brief Published usage per tag, the total last. */
+static _Atomic int64_t usage[HEAP_BUDGET_TAGS + 1];
+/** @brief Budget per tag, the total last; 0 means none. */
+static _Atomic size_t limits[HEAP_BUDGET_TAGS + 1];
+
+static HeapLimitHandler limit_handler = NULL;
+static void *limit_ctx = NULL;
+
+#if HEAP_THREAD_SAFE
+static pthread_key_t exit_key;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+
+static void flush_at_exit(void *unused) {
+    (void) unused;
+    for (unsigned tag = 0; tag < HEAP_BUDGET_TAGS; tag++) {
+        budget_flush(tag);
+    }
+}
+
+static void make_exit_key(void) {
+    pthread_key_create(&exit_key, flush_at_exit);
+}
+#endif
+
+/** @brief Whether the pending balances belong to the current heap. */
+static bool pending_current(void) {
+    return budget_seen_epoch ==
+           atomic_load_explicit(&budget_epoch, memory_order_relaxed);
+}
+
+void budget_join(void) {
+#if HEAP_THREAD_SAFE
+    pthread_once(&exit_key_once, make_exit_key);
+    pthread_setspecific(exit_key, &budget_seen_epoch); // Any non-NULL value
+#endif
+    for (unsigned tag = 0; tag < HEAP_BUDGET_TAGS; tag++) {
+        budget_pending[tag] = 0;
+    }
+    budget_seen_epoch =
+        atomic_load_explicit(&budget_epoch, memory_order_relaxed);
+}
+
+void budget_flush(unsigned tag) {
+    if (!pending_current()) {
+        budget_join();
+        return;
+    }
+    int64_t delta = budget_pending[tag];
+    budget_pending[tag] = 0;
+    if (delta != 0) {
+        atomic_fetch_add_explicit(&usage[tag], delta, memory_order_relaxed);
+        atomic_fetch_add_explicit(&usage[HEAP_BUDGET_TOTAL], delta,
+                                  memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Usage of 'tag' as seen by the current thread.
+ */
+static size_t usage_of(unsigned tag) {
+    int64_t used = atomic_load_explicit(&usage[tag], memory_order_relaxed);
+    if (pending_current()) {
+        for (unsigned t = 0; t < HEAP_BUDGET_TAGS; t++) {
+            if (t == tag || tag == HEAP_BUDGET_TOTAL) {
+                used += budget_pending[t];
+            }
+        }
+    }
+    return used > 0 ? (size_t) used : 0;
+}
+
+static void notify(HeapLimitReason reason, unsigned tag, size_t size) {
+    if (limit_handler == NULL) {
+        return;
+    }
+    HeapLimitEvent event = {
+        .reason = reason,
+        .tag = tag,
+        .size = size,
+        .usage = usage_of(tag),
+        .limit = atomic_load_explicit(&limits[tag], memory_order_relaxed),
+    };
+    limit_handler(&event, limit_ctx);
+}
+
+bool budget_check(unsigned tag, size_t size) {
+    const unsigned checked[2] = {tag, HEAP_BUDGET_TOTAL};
+    for (size_t i = 0; i < 2; i++) {
+        size_t limit =
+            atomic_load_explicit(&limits[checked[i]], memory_order_relaxed);
+        if (limit != 0 &&
+            (size > limit || usage_of(checked[i]) > limit - size)) {
+            notify(HEAP_LIMIT_BUDGET, checked[i], size);
+            return false;
+        }
+    }
+    return true;
+}
+
+void budget_no_memory(size_t size) {
+    notify(HEAP_LIMIT_NO_MEMORY, budget_tag, size);
+}
+
+void budget_reset(void) {
+    for (unsigned tag = 0; tag <= HEAP_BUDGET_TOTAL; tag++) {
+        atomic_store_explicit(&usage[tag], 0, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&budget_epoch, 1, memory_order_relaxed);
+}
+
+void allocator_set_budget(unsigned tag, size_t limit) {
+    if (tag > HEAP_BUDGET_TOTAL) {
+        return;
+    }
+    atomic_store_explicit(&limits[tag], limit, memory_order_relaxed);
+
+    bool any = false;
+    for (unsigned t = 0; t <= HEAP_BUDGET_TOTAL; t++) {
+        any |= atomic_load_explicit(&limits[t], memory_order_relaxed) != 0;
+    }
+    atomic_store_explicit(&budget_limited, any, memory_order_relaxed);
+}
+
+size_t allocator_get_budget_usage(unsigned tag) {
+    if (tag > HEAP_BUDGET_TOTAL) {
+        return 0;
+    }
+    for (unsigned t = 0; t < HEAP_BUDGET_TAGS; t++) {
+        budget_flush(t);
+    }
+    return usage_of(tag);
+}
+
+unsigned allocator_set_thread_tag(unsigned tag) {
+    unsigned previous = budget_tag;
+    if (tag < HEAP_BUDGET_TAGS) {
+        budget_tag = tag;
+    }
+    return previous;
+}
+
+void allocator_set_limit_handler(HeapLimitHandler handler, void *ctx) {
+    limit_handler = handler;
+    limit_ctx = ctx;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file heap_budget.h
+ * @brief Internal interface of the memory budgets.
+ *
+ * Only built when HEAP_BUDGETS is enabled. Each thread adds the sizes of
+ * the blocks it allocates and frees to a private per-tag balance, and only
+ * publishes it to the shared atomic counters once it reaches
+ * HEAP_BUDGET_BATCH bytes either way. Without any budget set, admitting an
+ * allocation is a single relaxed load.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_BUDGET_H
+#define HEAP_BUDGET_H
+
+#include "my_allocator.h"
+#include <stdatomic.h>
+
+/** @brief Tag the current thread's allocations are charged to. */
+extern _Thread_local unsigned budget_tag;
+
+/** @brief Bytes the current thread has not published yet, per tag. */
+extern _Thread_local int64_t budget_pending[HEAP_BUDGET_TAGS];
+
+/** @brief allocator_init() epoch the pending balances belong to. */
+extern _Thread_local unsigned budget_seen_epoch;
+
+/** @brief Bumped by allocator_init(), voiding older pending balances. */
+extern atomic_uint budget_epoch;
+
+/** @brief Whether any budget is set. */
+extern atomic_bool budget_limited;
+
+/**
+ * @brief Publishes the pending balance of 'tag'.
+ */
+void budget_flush(unsigned tag);
+
+/**
+ * @brief Starts accounting on a thread that is new or last ran before the
+ * latest allocator_init().
+ */
+void budget_join(void);
+
+/**
+ * @brief Adds 'delta' bytes to 'tag' on behalf of the current thread.
+ */
+static inline void budget_charge(unsigned tag, int64_t delta) {
+    if (budget_seen_epoch !=
+        atomic_load_explicit(&budget_epoch, memory_order_relaxed)) {
+        budget_join();
+    }
+    budget_pending[tag] += delta;
+    if (budget_pending[tag] >= HEAP_BUDGET_BATCH ||
+        budget_pending[tag] <= -HEAP_BUDGET_BATCH) {
+        budget_flush(tag);
+    }
+}
+
+/**
+ * @brief Checks a 'size'-byte block against the budgets, calling the limit
+ * handler if it does not fit.
+ */
+bool budget_check(unsigned tag, size_t size);
+
+/**
+ * @brief Whether the current thread may allocate a 'size'-byte block.
+ */
+static inline bool budget_admit(size_t size) {
+    return !atomic_load_explicit(&budget_limited, memory_order_relaxed) ||
+           budget_check(budget_tag, size);
+}
+
+/**
+ * @brief Tells the limit handler that no block of 'size' bytes was found.
+ */
+void budget_no_memory(size_t size);
+
+/**
+ * @brief Clears all usage (allocator_init()); budgets are kept.
+ */
+void budget_reset(void);
+
+#endif // HEAP_BUDGET_H
@@ -0,0 +1,187 @@
+/**
+ * @file heap_file.c
+ * @brief Maps heap files and shared memory objects with MAP_SHARED.
+ *
+ * A new heap is created with its magic cleared; the creator formats the
+ * heap and then publishes the magic with a release store. Other processes
+ * opening the same object wait for the magic before using the heap, so
+ * they never see a half-formatted free list.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_file.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** @brief How long an opener waits for another process to format a heap. */
+#define HEAP_FILE_WAIT_MS 1000
+
+/**
+ * @brief Sleeps for one millisecond while waiting on another process.
+ */
+static void wait_a_moment(void) {
+    struct timespec delay = {0, 1000000};
+    nanosleep(&delay, NULL);
+}
+
+/**
+ * @brief Checks that an existing file holds a heap this build can use.
+ */
+static bool header_valid(const HeapFileHeader *header, size_t file_size) {
+    return header->version == HEAP_FILE_VERSION &&
+           header->layout == HEAP_FILE_LAYOUT &&
+           header->heap_size <= file_size - HEAP_FILE_HEADER_SIZE;
+}
+
+/**
+ * @brief Waits until the heap in 'header' has been published.
+ */
+static bool wait_for_magic(const HeapFileHeader *header) {
+    for (int waited = 0; waited < HEAP_FILE_WAIT_MS; waited++) {
+        uint64_t magic = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE);
+        if (magic != 0) {
+            return magic == HEAP_FILE_MAGIC;
+        }
+        wait_a_moment();
+    }
+    return false;
+}
+
+/**
+ * @brief Prepares the header of a new heap, leaving it unpublished.
+ */
+static void header_format(HeapFileHeader *header, size_t heap_size) {
+    header->magic = 0;
+    header->version = HEAP_FILE_VERSION;
+    header->layout = HEAP_FILE_LAYOUT;
+    header->heap_size = heap_size;
+    header->free_head = BLOCK_NONE;
+    header->root = BLOCK_NONE;
+
+#if HEAP_THREAD_SAFE
+    // Robust, so a process dying with the lock held does not wedge others.
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+}
+
+/**
+ * @brief Sizes (if fresh) and maps an open heap object, then closes 'fd'.
+ */
+static HeapFileHeader *map_fd(int fd, const char *name, size_t heap_size,
+                              bool fresh) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("heap_file_open: fstat failed");
+        close(fd);
+        return NULL;
+    }
+
+    size_t file_size = (size_t) st.st_size;
+    if (fresh) {
+        file_size = HEAP_FILE_HEADER_SIZE + heap_size;
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t) file_size) != 0) {
+            perror("heap_file_open: ftruncate failed");
+            close(fd);
+            return NULL;
+        }
+    } else if (file_size < HEAP_FILE_HEADER_SIZE) {
+        fprintf(stderr, "Error: %s is too small to be a heap.\n", name);
+        close(fd);
+        return NULL;
+    }
+
+    void *mem =
+        mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping keeps the object open.
+    if (mem == MAP_FAILED) {
+        perror("heap_file_open: mmap failed");
+        return NULL;
+    }
+
+    HeapFileHeader *header = (HeapFileHeader *) mem;
+    if (fresh) {
+        header_format(header, heap_size);
+    } else if (!wait_for_magic(header) || !header_valid(header, file_size)) {
+        fprintf(stderr, "Error: %s is not a heap written by this build.\n",
+                name);
+        munmap(mem, file_size);
+        return NULL;
+    }
+
+    return header;
+}
+
+HeapFileHeader *heap_file_open(const char *path, size_t heap_size, bool reset,
+                               bool *fresh) {
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+        perror("heap_file_open: open failed");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("heap_file_open: fstat failed");
+        close(fd);
+        return NULL;
+    }
+
+    *fresh = reset || st.st_size == 0;
+    return map_fd(fd, path, heap_size, *fresh);
+}
+
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+HeapFileHeader *heap_shm_open(const char *name, size_t heap_size, bool reset,
+                              bool *fresh) {
+    // O_EXCL decides which process creates, and so formats, the segment.
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    *fresh = fd >= 0 || reset;
+    if (fd < 0 && errno == EEXIST) {
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        perror("heap_shm_open: shm_open failed");
+        return NULL;
+    }
+
+    // The creator may not have sized the segment yet.
+    struct stat st;
+    for (int waited = 0; !*fresh && waited < HEAP_FILE_WAIT_MS; waited++) {
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            break;
+        }
+        wait_a_moment();
+    }
+
+    return map_fd(fd, name, heap_size, *fresh);
+}
+#endif
+
+void heap_file_publish(HeapFileHeader *header) {
+    __atomic_store_n(&header->magic, HEAP_FILE_MAGIC, __ATOMIC_RELEASE);
+}
+
+int heap_file_sync(HeapFileHeader *header) {
+    return msync(header, HEAP_FILE_HEADER_SIZE + header->heap_size,
+                 MS_SYNC) == 0
+               ? 0
+               : -1;
+}
+
+void heap_file_close(HeapFileHeader *header) {
+    size_t length = HEAP_FILE_HEADER_SIZE + header->heap_size;
+    msync(header, length, MS_SYNC);
+    munmap(header, length);
+}
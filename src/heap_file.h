@@ -0,0 +1,87 @@
+/**
+ * @file heap_file.h
+ * @brief Internal interface for heaps that live in a shared mapping of a
+ * file or a POSIX shared memory object.
+ *
+ * The mapping starts with a HeapFileHeader followed by the heap itself.
+ * Everything inside is stored as offsets, so the heap can be mapped at a
+ * different address by the next (or another) process that opens it.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_FILE_H
+#define HEAP_FILE_H
+
+#include "my_allocator.h"
+#include <pthread.h>
+
+#define HEAP_FILE_MAGIC 0x31474E4550414548ULL ///< "HEAPENG1"
+#define HEAP_FILE_VERSION 1
+
+/** @brief Identifies the block layout a heap file was written with. */
+#define HEAP_FILE_LAYOUT ((uint32_t) (sizeof(BlockHeader) << 8 | ALIGNMENT))
+
+/**
+ * @brief Header stored at offset 0 of a file-backed heap.
+ */
+typedef struct {
+    uint64_t magic;    ///< HEAP_FILE_MAGIC once formatted, 0 before
+    uint32_t version;  ///< HEAP_FILE_VERSION
+    uint32_t layout;   ///< HEAP_FILE_LAYOUT of the writer
+    size_t heap_size;  ///< Bytes of heap following the header
+    size_t free_head;  ///< Offset of the first free block, or BLOCK_NONE
+    size_t root;       ///< Offset of the user's root object, or BLOCK_NONE
+    /** @brief Process-shared, robust lock (HEAP_THREAD_SAFE builds). */
+    pthread_mutex_t lock;
+} HeapFileHeader;
+
+/** @brief Distance from the start of the mapping to the heap. */
+#define HEAP_FILE_HEADER_SIZE                                                  \
+    ((sizeof(HeapFileHeader) + 63) & ~(size_t) 63)
+
+/**
+ * @brief Maps a heap file, creating or resetting it if needed.
+ *
+ * @param path File to map.
+ * @param heap_size Heap size for a new file (ignored when resuming).
+ * @param reset Discard any existing contents.
+ * @param fresh Set to true if the caller must format the heap and then
+ * call heap_file_publish().
+ * @return The mapped header, or NULL on error (reported on stderr).
+ */
+HeapFileHeader *heap_file_open(const char *path, size_t heap_size, bool reset,
+                               bool *fresh);
+
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+/**
+ * @brief Maps a shared memory heap, creating it if needed.
+ *
+ * Only the process that creates (or resets) the segment formats it; the
+ * others wait until it has been published.
+ *
+ * @see heap_file_open
+ */
+HeapFileHeader *heap_shm_open(const char *name, size_t heap_size, bool reset,
+                              bool *fresh);
+#endif
+
+/**
+ * @brief Marks a freshly formatted heap as ready for other openers.
+ */
+void heap_file_publish(HeapFileHeader *header);
+
+/**
+ * @brief Flushes the mapping to the file.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int heap_file_sync(HeapFileHeader *header);
+
+/**
+ * @brief Flushes and unmaps a heap file.
+ */
+void heap_file_close(HeapFileHeader *header);
+
+#endif // HEAP_FILE_H
@@ -0,0 +1,216 @@
+/**
+ * @file heap_free_index.c
+ * @brief Free-block summary index scanned with SSE2/AVX2 compares.
+ *
+ * The vector width is chosen at compile time: AVX2 when the compiler
+ * targets it (e.g. -march=native), SSE2 on any other x86-64, and a scalar
+ * loop elsewhere. Unsigned sizes are compared as signed after flipping
+ * their top bit, since SSE2/AVX2 only have signed 32-bit compares.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_free_index.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Entry position stored in the header of an indexed block.
+ */
+static uint32_t *position_of(const char *base, size_t offset) {
+    return &((BlockHeader *) (uintptr_t) (base + offset))->index_pos;
+}
+
+static uint32_t saturate(size_t size) {
+    return size > UINT32_MAX ? UINT32_MAX : (uint32_t) size;
+}
+
+/**
+ * @brief Looks up the entry of an indexed block, invalidating the index if
+ * the block is not where its stored position says.
+ */
+static size_t entry_of(FreeIndex *index, const char *base, size_t offset) {
+    size_t pos = *position_of(base, offset);
+    if (pos >= index->len || index->offsets[pos] != offset) {
+        index->valid = false;
+        return FREE_INDEX_NOT_FOUND;
+    }
+    return pos;
+}
+
+/**
+ * @brief Drops tombstones at the end, i.e. next to the list head.
+ */
+static void trim(FreeIndex *index) {
+    while (index->len > 0 && index->sizes[index->len - 1] == 0) {
+        index->len--;
+        index->tombstones--;
+    }
+}
+
+/**
+ * @brief Squeezes out all tombstones, keeping the order.
+ */
+static void squeeze(FreeIndex *index, char *base) {
+    size_t kept = 0;
+    for (size_t i = 0; i < index->len; i++) {
+        if (index->sizes[i] == 0) {
+            continue;
+        }
+        index->sizes[kept] = index->sizes[i];
+        index->offsets[kept] = index->offsets[i];
+        *position_of(base, index->offsets[kept]) = (uint32_t) kept;
+        kept++;
+    }
+    index->len = kept;
+    index->tombstones = 0;
+}
+
+void free_index_reset(FreeIndex *index) {
+    index->len = 0;
+    index->tombstones = 0;
+    index->valid = !index->disabled;
+    index->rebuild_backoff = 0;
+}
+
+bool free_index_begin_fill(FreeIndex *index, size_t count) {
+    index->valid = count <= FREE_INDEX_REBUILD_LIMIT;
+    index->len = index->valid ? count : 0;
+    index->tombstones = 0;
+    return index->valid;
+}
+
+void free_index_fill(FreeIndex *index, char *base, size_t nth, size_t offset,
+                     size_t size) {
+    size_t pos = index->len - 1 - nth;
+    index->sizes[pos] = saturate(size);
+    index->offsets[pos] = offset;
+    *position_of(base, offset) = (uint32_t) pos;
+}
+
+size_t free_index_entry(const FreeIndex *index, const char *base,
+                        size_t offset) {
+    size_t pos = *position_of(base, offset);
+    if (!index->valid || pos >= index->len ||
+        index->offsets[pos] != offset || index->sizes[pos] == 0) {
+        return FREE_INDEX_NOT_FOUND;
+    }
+    return pos;
+}
+
+void free_index_push(FreeIndex *index, char *base, size_t offset,
+                     size_t size) {
+    if (!index->valid) {
+        return;
+    }
+    if (index->len == HEAP_FREE_INDEX_CAPACITY) {
+        // Squeezing a nearly live index would repeat on every push.
+        if (index->tombstones < HEAP_FREE_INDEX_CAPACITY / 8) {
+            index->valid = false; // Rebuilt once the list is shorter.
+            return;
+        }
+        squeeze(index, base);
+        if (index->len == HEAP_FREE_INDEX_CAPACITY) {
+            index->valid = false;
+            return;
+        }
+    }
+
+    index->sizes[index->len] = saturate(size);
+    index->offsets[index->len] = offset;
+    *position_of(base, offset) = (uint32_t) index->len;
+    index->len++;
+}
+
+void free_index_remove(FreeIndex *index, char *base, size_t offset) {
+    if (!index->valid) {
+        return;
+    }
+    size_t pos = entry_of(index, base, offset);
+    if (pos != FREE_INDEX_NOT_FOUND) {
+        index->sizes[pos] = 0;
+        index->tombstones++;
+        trim(index);
+    }
+}
+
+void free_index_replace(FreeIndex *index, char *base, size_t old_offset,
+                        size_t offset, size_t size) {
+    if (!index->valid) {
+        return;
+    }
+    size_t pos = entry_of(index, base, old_offset);
+    if (pos != FREE_INDEX_NOT_FOUND) {
+        index->sizes[pos] = saturate(size);
+        index->offsets[pos] = offset;
+        *position_of(base, offset) = (uint32_t) pos;
+    }
+}
+
+void free_index_resize(FreeIndex *index, const char *base, size_t offset,
+                       size_t size) {
+    if (!index->valid) {
+        return;
+    }
+    size_t pos = entry_of(index, base, offset);
+    if (pos != FREE_INDEX_NOT_FOUND) {
+        index->sizes[pos] = saturate(size);
+    }
+}
+
+size_t free_index_find(const FreeIndex *index, size_t size, size_t end) {
+    const uint32_t need = saturate(size);
+    const uint32_t *sizes = index->sizes;
+    size_t i = end;
+
+#if defined(__AVX2__)
+    const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+    const __m256i below =
+        _mm256_set1_epi32((int32_t) ((need - 1) ^ 0x80000000u));
+    while (i >= 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (sizes + i - 8));
+        __m256i fits = _mm256_cmpgt_epi32(_mm256_xor_si256(v, flip), below);
+        unsigned mask =
+            (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(fits));
+        if (mask != 0) {
+            return i - 8 + (size_t) (31 - __builtin_clz(mask));
+        }
+        i -= 8;
+    }
+#elif defined(__SSE2__)
+    const __m128i flip = _mm_set1_epi32(INT32_MIN);
+    const __m128i below =
+        _mm_set1_epi32((int32_t) ((need - 1) ^ 0x80000000u));
+    while (i >= 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (sizes + i - 4));
+        __m128i fits = _mm_cmpgt_epi32(_mm_xor_si128(v, flip), below);
+        unsigned mask = (unsigned) _mm_movemask_ps(_mm_castsi128_ps(fits));
+        if (mask != 0) {
+            return i - 4 + (size_t) (31 - __builtin_clz(mask));
+        }
+        i -= 4;
+    }
+#endif
+
+    while (i > 0) {
+        i--;
+        if (sizes[i] >= need) {
+            return i;
+        }
+    }
+    return FREE_INDEX_NOT_FOUND;
+}
+
+size_t free_index_prev(const FreeIndex *index, size_t pos) {
+    for (size_t i = pos + 1; i < index->len; i++) {
+        if (index->sizes[i] != 0) {
+            return index->offsets[i];
+        }
+    }
+    return BLOCK_NONE;
+}
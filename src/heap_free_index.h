@@ -0,0 +1,115 @@
+/**
+ * @file heap_free_index.h
+ * @brief Internal interface of the free-block summary index.
+ *
+ * Only built when HEAP_FREE_INDEX is enabled. The index mirrors an arena's
+ * free list in a pair of contiguous arrays, in reverse list order: the list
+ * head is the last entry, so pushing a freed block is an append. Blocks
+ * leaving the list become tombstones (size 0) and keep the order intact.
+ * Scanning the sizes with SIMD compares finds the same first fit as the
+ * list walk without touching any block header on the way.
+ *
+ * Every indexed free block stores its entry position in its header
+ * (index_pos), so removals and in-place updates need no search.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_FREE_INDEX_H
+#define HEAP_FREE_INDEX_H
+
+#include "my_allocator.h"
+
+#define FREE_INDEX_NOT_FOUND SIZE_MAX
+
+/** @brief Longest free list rebuilt into the index, leaving some room. */
+#define FREE_INDEX_REBUILD_LIMIT (HEAP_FREE_INDEX_CAPACITY / 4 * 3)
+
+/** @brief Searches that skip rebuilding after a rebuild did not fit. */
+#define FREE_INDEX_REBUILD_BACKOFF (HEAP_FREE_INDEX_CAPACITY / 16 + 1)
+
+/**
+ * @brief Summary of one arena's free list.
+ */
+typedef struct {
+    /** @brief Block data sizes (saturated to 32 bits); 0 is a tombstone. */
+    uint32_t sizes[HEAP_FREE_INDEX_CAPACITY] __attribute__((aligned(32)));
+    /** @brief Block offsets, parallel to 'sizes'. */
+    size_t offsets[HEAP_FREE_INDEX_CAPACITY];
+    size_t len;               ///< Entries in use, tombstones included
+    size_t tombstones;        ///< Entries below 'len' with size 0
+    bool valid;               ///< Whether the index matches the free list
+    bool disabled;            ///< Set by allocator_set_free_index(false)
+    unsigned rebuild_backoff; ///< Searches left before the next rebuild
+} FreeIndex;
+
+/**
+ * @brief Empties the index and marks it valid, unless it is disabled.
+ */
+void free_index_reset(FreeIndex *index);
+
+/**
+ * @brief Stores the free list head-first: 'count' blocks are expected, and
+ * the first one passed to free_index_fill() becomes the last entry.
+ *
+ * @return false (and leaves the index invalid) if 'count' is above
+ * FREE_INDEX_REBUILD_LIMIT.
+ */
+bool free_index_begin_fill(FreeIndex *index, size_t count);
+
+/**
+ * @brief Adds the next block of a head-first fill.
+ *
+ * @param nth Position of the block in the free list, 0 for the head.
+ */
+void free_index_fill(FreeIndex *index, char *base, size_t nth, size_t offset,
+                     size_t size);
+
+/**
+ * @brief Looks up the entry of the free block at 'offset'.
+ *
+ * @return Entry position, or FREE_INDEX_NOT_FOUND if the index is invalid.
+ */
+size_t free_index_entry(const FreeIndex *index, const char *base,
+                        size_t offset);
+
+/**
+ * @brief Records a block pushed at the head of the free list.
+ */
+void free_index_push(FreeIndex *index, char *base, size_t offset,
+                     size_t size);
+
+/**
+ * @brief Records a block unlinked from the free list.
+ */
+void free_index_remove(FreeIndex *index, char *base, size_t offset);
+
+/**
+ * @brief Records that the block at 'old_offset' was replaced in the free
+ * list by the block at 'offset' (the remainder of a split).
+ */
+void free_index_replace(FreeIndex *index, char *base, size_t old_offset,
+                        size_t offset, size_t size);
+
+/**
+ * @brief Records a new size for an indexed block.
+ */
+void free_index_resize(FreeIndex *index, const char *base, size_t offset,
+                       size_t size);
+
+/**
+ * @brief Finds the entry nearest the list head, below position 'end',
+ * whose size is at least 'size'.
+ *
+ * @return Entry position, or FREE_INDEX_NOT_FOUND.
+ */
+size_t free_index_find(const FreeIndex *index, size_t size, size_t end);
+
+/**
+ * @brief Returns the offset of the list predecessor of entry 'pos', or
+ * BLOCK_NONE if that entry is the list head.
+ */
+size_t free_index_prev(const FreeIndex *index, size_t pos);
+
+#endif // HEAP_FREE_INDEX_H
@@ -0,0 +1,231 @@
+/**
+ * @file heap_guard.c
+ * @brief Sampled guard-page allocations for the hardened debug mode.
+ *
+ * The pool is one mapping of HEAP_GUARD_SLOTS data pages interleaved with
+ * PROT_NONE guard pages: [guard][slot 0][guard][slot 1]...[guard]. A
+ * sampled allocation is right-aligned in its slot page, so writing past its
+ * end touches the guard page and faults. Freed slots are made PROT_NONE
+ * and reused round-robin, so a dangling pointer faults until the slot comes
+ * around again.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_guard.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/** @brief Bookkeeping for one guarded slot (kept outside the pool). */
+typedef struct {
+    char *user_ptr; ///< Pointer handed out, or NULL if the slot is unused.
+    size_t size;    ///< Requested size of the allocation.
+} GuardSlot;
+
+static char *pool = NULL;
+static size_t pool_size = 0;
+static size_t page_size = 0;
+static GuardSlot slots[HEAP_GUARD_SLOTS];
+static size_t next_slot = 0;
+
+static size_t sample_rate = HEAP_GUARD_SAMPLE_RATE;
+static _Thread_local size_t sample_countdown = HEAP_GUARD_SAMPLE_RATE;
+
+static HeapGuardStats stats;
+
+/** @brief Guards the pool state; only taken on guarded (sampled) paths. */
+static atomic_flag pool_lock = ATOMIC_FLAG_INIT;
+
+static void lock_pool(void) {
+    while (atomic_flag_test_and_set_explicit(&pool_lock,
+                                             memory_order_acquire)) {
+    }
+}
+
+static void unlock_pool(void) {
+    atomic_flag_clear_explicit(&pool_lock, memory_order_release);
+}
+
+/**
+ * @brief Maps the pool on first use.
+ *
+ * @return true if the pool is available.
+ */
+static bool pool_map(void) {
+    if (pool != NULL) {
+        return true;
+    }
+
+    page_size = (size_t) sysconf(_SC_PAGESIZE);
+    pool_size = (2 * HEAP_GUARD_SLOTS + 1) * page_size;
+
+    void *mem = mmap(NULL, pool_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("guard_malloc: mmap failed");
+        pool_size = 0;
+        return false;
+    }
+
+    pool = (char *) mem;
+    return true;
+}
+
+/**
+ * @brief Returns the data page of slot 'index'.
+ */
+static char *slot_page(size_t index) {
+    return pool + (2 * index + 1) * page_size;
+}
+
+/**
+ * @brief Finds the slot whose data page contains 'ptr'.
+ *
+ * @return Slot index, or HEAP_GUARD_SLOTS if 'ptr' is on a guard page.
+ */
+static size_t slot_index(const void *ptr) {
+    size_t page = (size_t) ((const char *) ptr - pool) / page_size;
+    return (page % 2 == 1) ? page / 2 : HEAP_GUARD_SLOTS;
+}
+
+bool guard_should_sample(void) {
+    if (--sample_countdown != 0) {
+        return false;
+    }
+    sample_countdown = (sample_rate != 0) ? sample_rate : SIZE_MAX;
+    return sample_rate != 0;
+}
+
+void *guard_malloc(size_t size) {
+    lock_pool();
+    if (!pool_map() || size > page_size) {
+        unlock_pool();
+        return NULL;
+    }
+
+    // Round-robin search, so recently freed slots stay inaccessible longest.
+    for (size_t i = 0; i < HEAP_GUARD_SLOTS; i++) {
+        size_t index = (next_slot + i) % HEAP_GUARD_SLOTS;
+        if (slots[index].user_ptr != NULL) {
+            continue;
+        }
+
+        char *page = slot_page(index);
+        if (mprotect(page, page_size, PROT_READ | PROT_WRITE) != 0) {
+            unlock_pool();
+            perror("guard_malloc: mprotect failed");
+            return NULL;
+        }
+
+        // Right-align against the trailing guard page and fill the
+        // alignment slack with canary bytes.
+        char *user_ptr = page + page_size - MY_ALLOC_ALIGN_UP(size);
+        memset(user_ptr + size, HEAP_CANARY_BYTE,
+               MY_ALLOC_ALIGN_UP(size) - size);
+
+        slots[index].user_ptr = user_ptr;
+        slots[index].size = size;
+        next_slot = (index + 1) % HEAP_GUARD_SLOTS;
+
+        stats.sampled_allocations++;
+        stats.guarded_live++;
+        unlock_pool();
+        return user_ptr;
+    }
+
+    unlock_pool();
+    return NULL;
+}
+
+bool guard_owns(const void *ptr) {
+    const char *cptr = (const char *) ptr;
+    return pool != NULL && cptr >= pool && cptr < pool + pool_size;
+}
+
+void guard_free(void *ptr) {
+    lock_pool();
+    size_t index = slot_index(ptr);
+    if (index == HEAP_GUARD_SLOTS || slots[index].user_ptr != ptr) {
+        unlock_pool();
+        fprintf(stderr,
+                "Error: Invalid or double free of guarded pointer %p.\n", ptr);
+        return;
+    }
+
+    const char *slack = slots[index].user_ptr + slots[index].size;
+    size_t slack_size =
+        MY_ALLOC_ALIGN_UP(slots[index].size) - slots[index].size;
+    for (size_t i = 0; i < slack_size; i++) {
+        if ((unsigned char) slack[i] != HEAP_CANARY_BYTE) {
+            fprintf(stderr,
+                    "Error: Heap overflow detected past guarded pointer %p "
+                    "(size %zu).\n",
+                    ptr, slots[index].size);
+            stats.canary_failures++;
+            break;
+        }
+    }
+
+    // Revoke access so a use-after-free faults.
+    mprotect(slot_page(index), page_size, PROT_NONE);
+    slots[index].user_ptr = NULL;
+    stats.guarded_live--;
+    unlock_pool();
+}
+
+size_t guard_usable_size(const void *ptr) {
+    lock_pool();
+    size_t index = slot_index(ptr);
+    size_t size = 0;
+    if (index != HEAP_GUARD_SLOTS && slots[index].user_ptr == ptr) {
+        size = slots[index].size;
+    }
+    unlock_pool();
+    return size;
+}
+
+void guard_note_canary_failure(void) {
+    lock_pool();
+    stats.canary_failures++;
+    unlock_pool();
+}
+
+void guard_reset(void) {
+    lock_pool();
+    if (pool != NULL) {
+        mprotect(pool, pool_size, PROT_NONE);
+    }
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    next_slot = 0;
+    sample_countdown = (sample_rate != 0) ? sample_rate : SIZE_MAX;
+    unlock_pool();
+}
+
+void guard_destroy(void) {
+    lock_pool();
+    if (pool != NULL) {
+        munmap(pool, pool_size);
+    }
+    pool = NULL;
+    pool_size = 0;
+    memset(slots, 0, sizeof(slots));
+    unlock_pool();
+}
+
+void allocator_set_guard_sample_rate(size_t rate) {
+    sample_rate = rate;
+    sample_countdown = (rate != 0) ? rate : SIZE_MAX;
+}
+
+void allocator_get_guard_stats(HeapGuardStats *out) {
+    if (out != NULL) {
+        lock_pool();
+        *out = stats;
+        unlock_pool();
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * @file heap_guard.h
+ * @brief Internal interface of the sampled guard-page pool (debug mode).
+ *
+ * Only built when HEAP_DEBUG_GUARD is enabled. A sampled allocation is
+ * placed at the very end of its own read/write page, with PROT_NONE guard
+ * pages on both sides, so overflows and use-after-free fault immediately.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+#include "my_allocator.h"
+
+/**
+ * @brief Counts down to the next sampled allocation.
+ *
+ * @return true if the current allocation should go to the guard pool.
+ */
+bool guard_should_sample(void);
+
+/**
+ * @brief Places an allocation against a guard page.
+ *
+ * @param size Requested size in bytes.
+ * @return Pointer to the guarded memory, or NULL if no slot is available.
+ */
+void *guard_malloc(size_t size);
+
+/**
+ * @brief Checks whether 'ptr' points into the guard pool.
+ */
+bool guard_owns(const void *ptr);
+
+/**
+ * @brief Releases a guarded allocation and revokes access to its page.
+ */
+void guard_free(void *ptr);
+
+/**
+ * @brief Returns the requested size of a live guarded allocation.
+ */
+size_t guard_usable_size(const void *ptr);
+
+/**
+ * @brief Records a corrupted trailing canary found on a heap block.
+ */
+void guard_note_canary_failure(void);
+
+/**
+ * @brief Releases all slots and restarts sampling (allocator_init()).
+ */
+void guard_reset(void);
+
+/**
+ * @brief Unmaps the guard pool (allocator_destroy()).
+ */
+void guard_destroy(void);
+
+#endif // HEAP_GUARD_H
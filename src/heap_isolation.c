@@ -0,0 +1,141 @@
+/**
+ * @file heap_isolation.c
+ * @brief Per-thread runs for cache-line isolated objects.
+ *
+ * A run counts its live objects, plus one while its thread still carves
+ * from it. Whoever drops the count to zero hands the run back to the
+ * allocator to be freed. A thread retires its run when it adopts a new
+ * one, and when it exits, through a pthread key destructor.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_isolation.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/**
+ * @brief Header in the first cache line of a run.
+ */
+typedef struct {
+    uint32_t magic;     ///< RUN_MAGIC while the run is live
+    atomic_size_t live; ///< Live objects, plus one for the carving thread
+} RunHeader;
+
+#define RUN_MAGIC 0x15011A7Eu ///< Tells a live run from any other memory.
+
+_Thread_local bool isolation_enabled = false;
+
+static _Thread_local char *current_run = NULL;
+static _Thread_local size_t current_used = 0; ///< Bytes carved so far
+static _Thread_local unsigned seen_epoch = 0;
+// Starts ahead of seen_epoch, so no thread has a current run at first.
+static atomic_uint epoch = 1;
+
+static pthread_key_t exit_key;
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+
+/** @brief Whether the current run belongs to the current heap. */
+static bool run_current(void) {
+    return current_run != NULL &&
+           seen_epoch == atomic_load_explicit(&epoch, memory_order_relaxed);
+}
+
+/**
+ * @brief Drops the current thread's hold on its run.
+ *
+ * @return The run if it must now be freed, or NULL.
+ */
+static void *retire_current(void) {
+    RunHeader *run = (RunHeader *) current_run;
+    bool live = run_current();
+    current_run = NULL;
+    if (live &&
+        atomic_fetch_sub_explicit(&run->live, 1, memory_order_acq_rel) == 1) {
+        run->magic = 0;
+        return run;
+    }
+    return NULL;
+}
+
+static void retire_at_exit(void *unused) {
+    (void) unused;
+    void *run = retire_current();
+    if (run != NULL) {
+        my_free(run);
+    }
+}
+
+static void make_exit_key(void) {
+    pthread_key_create(&exit_key, retire_at_exit);
+}
+
+void *isolation_carve(size_t size) {
+    if (!run_current()) {
+        return NULL;
+    }
+    size_t need = 2 * sizeof(size_t) + MY_ALLOC_ALIGN_UP(size);
+    if (need > HEAP_ISOLATION_RUN_SIZE - current_used) {
+        return NULL;
+    }
+
+    size_t *words = (size_t *) (current_run + current_used);
+    current_used += need;
+    words[0] = size;
+    words[1] = (size_t) ((char *) &words[1] - current_run) | ISOLATION_TAG;
+    atomic_fetch_add_explicit(&((RunHeader *) current_run)->live, 1,
+                              memory_order_relaxed);
+    return &words[2];
+}
+
+void *isolation_adopt(void *run) {
+    pthread_once(&exit_key_once, make_exit_key);
+    pthread_setspecific(exit_key, run); // Any non-NULL value
+    void *retired = retire_current();
+
+    ((RunHeader *) run)->magic = RUN_MAGIC;
+    atomic_init(&((RunHeader *) run)->live, 1);
+    current_run = (char *) run;
+    current_used = HEAP_CACHE_LINE;
+    seen_epoch = atomic_load_explicit(&epoch, memory_order_relaxed);
+    return retired;
+}
+
+void *isolation_run_of(const void *ptr) {
+    const size_t *offset_word = (const size_t *) ptr - 1;
+    size_t offset = *offset_word & ~ISOLATION_TAG;
+    // Objects follow the header line and end inside the run.
+    if (offset < HEAP_CACHE_LINE + sizeof(size_t) ||
+        offset > HEAP_ISOLATION_RUN_SIZE - sizeof(size_t)) {
+        return NULL;
+    }
+    return (char *) offset_word - offset;
+}
+
+bool isolation_run_live(const void *run) {
+    return ((const RunHeader *) run)->magic == RUN_MAGIC;
+}
+
+void *isolation_release(void *ptr) {
+    size_t *offset_word = (size_t *) ptr - 1;
+    RunHeader *run = (RunHeader *) isolation_run_of(ptr);
+    // A second free of 'ptr' now fails the block header check.
+    *offset_word = 0;
+    if (atomic_fetch_sub_explicit(&run->live, 1, memory_order_acq_rel) == 1) {
+        run->magic = 0;
+        return run;
+    }
+    return NULL;
+}
+
+void isolation_reset(void) {
+    atomic_fetch_add_explicit(&epoch, 1, memory_order_relaxed);
+}
+
+bool allocator_set_thread_isolation(bool enabled) {
+    bool previous = isolation_enabled;
+    isolation_enabled = enabled;
+    return previous;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file heap_isolation.h
+ * @brief Internal interface of the cache-line isolation.
+ *
+ * Only built when HEAP_ISOLATION is enabled. Each thread carves its small
+ * isolated objects from a run of its own: a HEAP_ISOLATION_RUN_SIZE block
+ * on a cache line boundary, so no line of a run holds another thread's
+ * objects. The first line of a run holds its header. Every object follows
+ * a size word and an offset word leading back to the run; the offset has
+ * bit 0 set, which the offset word of an ordinary block never has.
+ *
+ * A run is freed with its last object once its thread has moved on to a
+ * new run or exited.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_ISOLATION_H
+#define HEAP_ISOLATION_H
+
+#include "my_allocator.h"
+
+/** @brief Bit set in the offset word of objects carved from a run. */
+#define ISOLATION_TAG ((size_t) 1)
+
+/** @brief Largest request carved from a run; larger ones get own lines. */
+#define ISOLATION_MAX_CARVED (HEAP_ISOLATION_RUN_SIZE / 4)
+
+/** @brief Whether the current thread isolates all its allocations. */
+extern _Thread_local bool isolation_enabled;
+
+/**
+ * @brief Whether 'ptr', an aligned pointer into the heap, was carved from
+ * a run.
+ */
+static inline bool isolation_owns(const void *ptr) {
+    return (((const size_t *) ptr)[-1] & ISOLATION_TAG) != 0;
+}
+
+/** @brief Size requested for an object carved from a run. */
+static inline size_t isolation_size(const void *ptr) {
+    return ((const size_t *) ptr)[-2];
+}
+
+/**
+ * @brief Carves 'size' bytes from the current thread's run.
+ *
+ * @return NULL if the thread has no current run or it is full.
+ */
+void *isolation_carve(size_t size);
+
+/**
+ * @brief Makes 'run', HEAP_ISOLATION_RUN_SIZE bytes on a cache line
+ * boundary, the current thread's run.
+ *
+ * @return The previous run if it must now be freed, or NULL.
+ */
+void *isolation_adopt(void *run);
+
+/**
+ * @brief Run the offset word in front of 'ptr' leads to, or NULL if no
+ * object carved from a run can have that offset.
+ *
+ * Only does arithmetic; the caller checks the run lies in a live block.
+ */
+void *isolation_run_of(const void *ptr);
+
+/**
+ * @brief Whether 'run', inside a live heap block, holds a run header.
+ */
+bool isolation_run_live(const void *run);
+
+/**
+ * @brief Releases an object carved from a run, which the caller validated.
+ *
+ * @return Its run if it must now be freed, or NULL.
+ */
+void *isolation_release(void *ptr);
+
+/**
+ * @brief Forgets the runs of every thread, when the heap is (re)started.
+ */
+void isolation_reset(void);
+
+#endif // HEAP_ISOLATION_H
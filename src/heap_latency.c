@@ -0,0 +1,256 @@
+/**
+ * @file heap_latency.c
+ * @brief Lock-free log-linear latency histograms.
+ *
+ * Buckets follow the HDR histogram layout: values below 2^SUB_BITS get one
+ * bucket each, and every power of two above is split into 2^SUB_BITS
+ * linear sub-buckets, so a bucket is never wider than 1 / 2^SUB_BITS of its
+ * values. Counters are relaxed atomics; recording never takes a lock.
+ *
+ * Latencies are kept in ticks. With HEAP_LATENCY_TSC these are (invariant)
+ * TSC cycles, converted to nanoseconds when read by comparing the TSC with
+ * the monotonic clock over the time since the last reset.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_latency.h"
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SUB_COUNT ((uint64_t) 1 << HEAP_LATENCY_SUB_BITS)
+#define MAX_MAGNITUDE 47 ///< Slower calls all land in the last bucket.
+#define BUCKETS                                                                \
+    ((size_t) (MAX_MAGNITUDE - HEAP_LATENCY_SUB_BITS + 2) * SUB_COUNT)
+
+_Thread_local unsigned latency_depth = 0;
+_Thread_local size_t latency_walk = 0;
+
+static _Atomic uint64_t counts[HEAP_OP_COUNT][BUCKETS];
+static _Atomic uint64_t walks[BUCKETS]; ///< Walk sums of the malloc buckets
+static _Atomic uint64_t max_ticks[HEAP_OP_COUNT];
+
+// Clock readings taken together at the last reset, for calibration.
+static uint64_t origin_ticks = 0;
+static uint64_t origin_ns = 0;
+
+static const char *const op_names[HEAP_OP_COUNT] = {"malloc", "free",
+                                                    "realloc"};
+
+static uint64_t clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static size_t bucket_of(uint64_t ticks) {
+    if (ticks < SUB_COUNT) {
+        return (size_t) ticks;
+    }
+    unsigned magnitude = 63 - (unsigned) __builtin_clzll(ticks);
+    if (magnitude > MAX_MAGNITUDE) {
+        return BUCKETS - 1;
+    }
+    unsigned shift = magnitude - HEAP_LATENCY_SUB_BITS;
+    return (size_t) ((shift + 1) * SUB_COUNT + (ticks >> shift) - SUB_COUNT);
+}
+
+/**
+ * @brief Largest value that falls into 'bucket'.
+ */
+static uint64_t bucket_high(size_t bucket) {
+    if (bucket < SUB_COUNT) {
+        return bucket;
+    }
+    unsigned shift = (unsigned) (bucket / SUB_COUNT) - 1;
+    uint64_t low = (bucket % SUB_COUNT + SUB_COUNT) << shift;
+    return low + ((uint64_t) 1 << shift) - 1;
+}
+
+/**
+ * @brief Nanoseconds per tick.
+ *
+ * The TSC is calibrated over at least a millisecond, waiting if the last
+ * reset was more recent than that.
+ */
+static double ns_per_tick(void) {
+#if HEAP_LATENCY_TSC
+    uint64_t ns = clock_ns();
+    while (ns - origin_ns < 1000000) {
+        ns = clock_ns();
+    }
+    uint64_t ticks = latency_now();
+    return (double) (ns - origin_ns) / (double) (ticks - origin_ticks);
+#else
+    return 1.0;
+#endif
+}
+
+static uint64_t to_ns(uint64_t ticks, double scale) {
+    return (uint64_t) ((double) ticks * scale + 0.5);
+}
+
+void latency_record(HeapOp op, uint64_t ticks, size_t walk) {
+    size_t bucket = bucket_of(ticks);
+    atomic_fetch_add_explicit(&counts[op][bucket], 1, memory_order_relaxed);
+    if (op == HEAP_OP_MALLOC) {
+        atomic_fetch_add_explicit(&walks[bucket], walk, memory_order_relaxed);
+    }
+
+    uint64_t max = atomic_load_explicit(&max_ticks[op], memory_order_relaxed);
+    while (ticks > max && !atomic_compare_exchange_weak_explicit(
+                              &max_ticks[op], &max, ticks,
+                              memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+#if HEAP_LATENCY_DUMP_AT_EXIT
+static void dump_at_exit(void) {
+    allocator_dump_latency(stderr);
+}
+#endif
+
+void latency_reset(void) {
+#if HEAP_LATENCY_DUMP_AT_EXIT
+    static bool dump_registered = false;
+    if (!dump_registered) {
+        dump_registered = atexit(dump_at_exit) == 0;
+    }
+#endif
+    allocator_reset_latency();
+}
+
+void allocator_reset_latency(void) {
+    for (size_t op = 0; op < HEAP_OP_COUNT; op++) {
+        for (size_t i = 0; i < BUCKETS; i++) {
+            atomic_store_explicit(&counts[op][i], 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&max_ticks[op], 0, memory_order_relaxed);
+    }
+    for (size_t i = 0; i < BUCKETS; i++) {
+        atomic_store_explicit(&walks[i], 0, memory_order_relaxed);
+    }
+    origin_ns = clock_ns();
+    origin_ticks = latency_now();
+}
+
+/**
+ * @brief Copies the counters of 'op' so they can be summed consistently.
+ *
+ * @return Total number of calls in the snapshot.
+ */
+static uint64_t snapshot(HeapOp op, uint64_t *snap) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        snap[i] = atomic_load_explicit(&counts[op][i], memory_order_relaxed);
+        total += snap[i];
+    }
+    return total;
+}
+
+/**
+ * @brief Bucket holding the 'q' quantile of a snapshot.
+ */
+static size_t quantile_bucket(const uint64_t *snap, uint64_t total,
+                              double q) {
+    uint64_t rank = (uint64_t) (q * (double) total);
+    if ((double) rank < q * (double) total || rank == 0) {
+        rank++; // Round up: the smallest value with 'q' of calls at or below.
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += snap[i];
+        if (seen >= rank) {
+            return i;
+        }
+    }
+    return BUCKETS - 1;
+}
+
+void allocator_get_latency_stats(HeapOp op, HeapLatencyStats *out) {
+    if (out == NULL) {
+        return;
+    }
+    *out = (HeapLatencyStats) {0};
+    if ((unsigned) op >= HEAP_OP_COUNT) {
+        return;
+    }
+
+    uint64_t snap[BUCKETS];
+    uint64_t total = snapshot(op, snap);
+    if (total == 0) {
+        return;
+    }
+
+    double scale = ns_per_tick();
+    size_t p99 = quantile_bucket(snap, total, 0.99);
+    out->count = total;
+    out->p50_ns = to_ns(bucket_high(quantile_bucket(snap, total, 0.5)), scale);
+    out->p90_ns = to_ns(bucket_high(quantile_bucket(snap, total, 0.9)), scale);
+    out->p99_ns = to_ns(bucket_high(p99), scale);
+    out->p999_ns =
+        to_ns(bucket_high(quantile_bucket(snap, total, 0.999)), scale);
+    out->max_ns = to_ns(
+        atomic_load_explicit(&max_ticks[op], memory_order_relaxed), scale);
+
+    if (op == HEAP_OP_MALLOC) {
+        uint64_t walk_sum = 0;
+        uint64_t tail_calls = 0;
+        uint64_t tail_walk_sum = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            uint64_t walk =
+                atomic_load_explicit(&walks[i], memory_order_relaxed);
+            walk_sum += walk;
+            if (i >= p99) {
+                tail_calls += snap[i];
+                tail_walk_sum += walk;
+            }
+        }
+        out->mean_walk = (double) walk_sum / (double) total;
+        out->tail_walk =
+            tail_calls > 0 ? (double) tail_walk_sum / (double) tail_calls : 0;
+    }
+}
+
+int allocator_dump_latency(FILE *out) {
+    if (out == NULL) {
+        return -1;
+    }
+
+    uint64_t snap[BUCKETS];
+    double scale = ns_per_tick();
+    fprintf(out, "heap latency: %.4f ns per tick (%s)\n", scale,
+            HEAP_LATENCY_TSC ? "rdtsc" : "clock_gettime");
+
+    for (HeapOp op = 0; op < HEAP_OP_COUNT; op++) {
+        HeapLatencyStats stats;
+        allocator_get_latency_stats(op, &stats);
+        fprintf(out,
+                "%s: %" PRIu64 " calls, p50 %" PRIu64 " ns, p90 %" PRIu64
+                " ns, p99 %" PRIu64 " ns, p99.9 %" PRIu64 " ns, max %" PRIu64
+                " ns\n",
+                op_names[op], stats.count, stats.p50_ns, stats.p90_ns,
+                stats.p99_ns, stats.p999_ns, stats.max_ns);
+
+        snapshot(op, snap);
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (snap[i] == 0) {
+                continue;
+            }
+            fprintf(out, "  <= %" PRIu64 " ns: %" PRIu64,
+                    to_ns(bucket_high(i), scale), snap[i]);
+            if (op == HEAP_OP_MALLOC) {
+                uint64_t walk =
+                    atomic_load_explicit(&walks[i], memory_order_relaxed);
+                fprintf(out, " (walk %.1f)",
+                        (double) walk / (double) snap[i]);
+            }
+            fputc('\n', out);
+        }
+    }
+
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file heap_latency.h
+ * @brief Internal interface of the latency histograms.
+ *
+ * Only built when HEAP_LATENCY is enabled. Each public entry point takes a
+ * timestamp on entry and records the elapsed ticks on exit. Calls made from
+ * inside another timed call (my_realloc() calling my_malloc()) are not
+ * recorded separately. Malloc calls also record how many free blocks were
+ * examined, which is counted through latency_walk.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_LATENCY_H
+#define HEAP_LATENCY_H
+
+#include "my_allocator.h"
+
+#if HEAP_LATENCY_TSC
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/** @brief Nesting depth of timed calls on the current thread. */
+extern _Thread_local unsigned latency_depth;
+
+/** @brief Free blocks examined by the current thread's outermost call. */
+extern _Thread_local size_t latency_walk;
+
+/**
+ * @brief Current time in ticks: TSC cycles or nanoseconds.
+ */
+static inline uint64_t latency_now(void) {
+#if HEAP_LATENCY_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Starts timing a call.
+ *
+ * @return Start time, or 0 for a nested call.
+ */
+static inline uint64_t latency_enter(void) {
+    if (latency_depth++ != 0) {
+        return 0;
+    }
+    latency_walk = 0;
+    return latency_now();
+}
+
+/**
+ * @brief Adds 'ticks' to the histogram of 'op', together with the current
+ * walk length for malloc calls.
+ */
+void latency_record(HeapOp op, uint64_t ticks, size_t walk);
+
+/**
+ * @brief Finishes timing a call started at 'start'.
+ */
+static inline void latency_leave(HeapOp op, uint64_t start) {
+    if (--latency_depth == 0) {
+        latency_record(op, latency_now() - start, latency_walk);
+    }
+}
+
+/**
+ * @brief Clears the histograms and, the first time, registers the exit
+ * dump (allocator_init()).
+ */
+void latency_reset(void);
+
+#endif // HEAP_LATENCY_H
@@ -0,0 +1,151 @@
+/**
+ * @file heap_maintenance.c
+ * @brief The background maintenance thread.
+ *
+ * The thread sleeps on a condition variable, so stopping it or asking it
+ * for a pass does not wait out the interval. The passes themselves are in
+ * my_allocator.c.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_maintenance.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+/** @brief Serializes starting and stopping. */
+static pthread_mutex_t control = PTHREAD_MUTEX_INITIALIZER;
+/** @brief Protects the fields below 'thread' and pairs with the conds. */
+static pthread_mutex_t state = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake;   ///< Wakes the thread
+static pthread_cond_t passed; ///< Signalled after each pass
+static bool wake_ready = false;
+
+static pthread_t thread;
+static bool running = false;
+static bool stopping = false;
+static bool alive = false;     ///< The thread can still serve requests
+static bool requested = false; ///< A pass was asked for
+static bool in_pass = false;
+static unsigned long passes_done = 0;
+static unsigned interval = 0;
+
+/**
+ * @brief 'now' plus 'ms' milliseconds.
+ */
+static struct timespec deadline_after(unsigned ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long) (ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+static void *maintenance_main(void *unused) {
+    (void) unused;
+    pthread_mutex_lock(&state);
+    while (!stopping) {
+        struct timespec deadline = deadline_after(interval);
+        int rc = 0;
+        while (!stopping && !requested && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&wake, &state, &deadline);
+        }
+        if (stopping) {
+            break;
+        }
+        requested = false;
+        in_pass = true;
+        pthread_mutex_unlock(&state);
+        allocator_run_maintenance();
+        pthread_mutex_lock(&state);
+        in_pass = false;
+        passes_done++;
+        pthread_cond_broadcast(&passed);
+    }
+    // Requests still waiting give up.
+    alive = false;
+    pthread_cond_broadcast(&passed);
+    pthread_mutex_unlock(&state);
+    return NULL;
+}
+
+bool maintenance_thread_start(unsigned interval_ms) {
+    pthread_mutex_lock(&control);
+    if (running) {
+        pthread_mutex_unlock(&control);
+        return false;
+    }
+    if (!wake_ready) {
+        // Deadlines are monotonic, so clock changes do not stall passes.
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&wake, &attr);
+        pthread_cond_init(&passed, &attr);
+        pthread_condattr_destroy(&attr);
+        wake_ready = true;
+    }
+
+    pthread_mutex_lock(&state);
+    stopping = false;
+    requested = false;
+    alive = true;
+    pthread_mutex_unlock(&state);
+    interval = interval_ms;
+    // The first pass must find the caches active.
+    maintenance_set_active(true);
+    running = pthread_create(&thread, NULL, maintenance_main, NULL) == 0;
+    if (!running) {
+        pthread_mutex_lock(&state);
+        alive = false;
+        pthread_mutex_unlock(&state);
+        maintenance_set_active(false);
+    }
+    bool started = running;
+    pthread_mutex_unlock(&control);
+    return started;
+}
+
+bool maintenance_thread_request_pass(void) {
+    pthread_mutex_lock(&state);
+    if (!alive || stopping) {
+        pthread_mutex_unlock(&state);
+        return false;
+    }
+    // A pass already under way may have walked past the caller's frees.
+    unsigned long target = passes_done + (in_pass ? 2 : 1);
+    requested = true;
+    pthread_cond_signal(&wake);
+    while (alive && passes_done < target) {
+        pthread_cond_wait(&passed, &state);
+    }
+    bool done = passes_done >= target;
+    pthread_mutex_unlock(&state);
+    return done;
+}
+
+bool maintenance_thread_stop(void) {
+    pthread_mutex_lock(&control);
+    if (!running) {
+        pthread_mutex_unlock(&control);
+        return false;
+    }
+
+    pthread_mutex_lock(&state);
+    stopping = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&state);
+
+    pthread_join(thread, NULL);
+    running = false;
+    maintenance_set_active(false);
+    pthread_mutex_unlock(&control);
+    return true;
+}
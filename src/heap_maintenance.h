@@ -0,0 +1,119 @@
+/**
+ * @file heap_maintenance.h
+ * @brief Internal interface of the background maintenance.
+ *
+ * Only built when HEAP_MAINTENANCE is enabled. While the maintenance
+ * thread runs, each arena's free path is a flag write or a push on a
+ * per-size cache, and the malloc path for cached sizes is a pop. Blocks
+ * that are marked free but sit neither in a cache nor on the free list
+ * are left for the next pass, which rebuilds the free list from a walk
+ * over the whole arena.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_MAINTENANCE_H
+#define HEAP_MAINTENANCE_H
+
+#include "my_allocator.h"
+
+/** @brief Largest block data size the caches hold. */
+#define MAINTENANCE_MAX_CACHED (HEAP_MAINTENANCE_BINS * ALIGNMENT)
+
+/**
+ * @brief Per-arena caches and counters, protected by the arena lock.
+ */
+typedef struct {
+    bool active;       ///< Frees are deferred and cached
+    unsigned unmerged; ///< Free blocks off the list since the last pass
+    unsigned count[HEAP_MAINTENANCE_BINS];  ///< Blocks in each cache
+    unsigned demand[HEAP_MAINTENANCE_BINS]; ///< Requests since last pass
+    BlockHeader *blocks[HEAP_MAINTENANCE_BINS][HEAP_MAINTENANCE_BIN_DEPTH];
+    HeapMaintenanceStats stats;
+} MaintenanceCache;
+
+/** @brief Cache holding blocks of 'size' data bytes. */
+static inline size_t cache_bin(size_t size) {
+    return size / ALIGNMENT - 1;
+}
+
+/**
+ * @brief Takes a cached block of exactly 'size' bytes, or returns NULL.
+ */
+static inline BlockHeader *cache_pop(MaintenanceCache *cache, size_t size) {
+    if (!cache->active || size > MAINTENANCE_MAX_CACHED) {
+        return NULL;
+    }
+    size_t bin = cache_bin(size);
+    cache->demand[bin]++;
+    if (cache->count[bin] == 0) {
+        cache->stats.cache_misses++;
+        return NULL;
+    }
+    cache->stats.cache_hits++;
+    BlockHeader *block = cache->blocks[bin][--cache->count[bin]];
+    block->is_free = false;
+    return block;
+}
+
+/**
+ * @brief Marks 'block' free and caches it if its cache has room.
+ *
+ * @return Whether the block was cached.
+ */
+static inline bool cache_push(MaintenanceCache *cache, BlockHeader *block) {
+    block->is_free = true;
+    if (block->size > MAINTENANCE_MAX_CACHED) {
+        return false;
+    }
+    size_t bin = cache_bin(block->size);
+    if (cache->count[bin] == HEAP_MAINTENANCE_BIN_DEPTH) {
+        return false;
+    }
+    cache->blocks[bin][cache->count[bin]++] = block;
+    return true;
+}
+
+/**
+ * @brief Forgets every cached block; they stay marked free.
+ */
+static inline void cache_clear(MaintenanceCache *cache) {
+    for (size_t bin = 0; bin < HEAP_MAINTENANCE_BINS; bin++) {
+        cache->count[bin] = 0;
+    }
+}
+
+/**
+ * @brief Turns the caches of every arena on, or off after merging them back
+ * into the free lists. Defined in my_allocator.c.
+ *
+ * Called while the thread is stopped, before it starts and after it exits.
+ */
+void maintenance_set_active(bool active);
+
+/**
+ * @brief Activates the caches, then starts the thread calling
+ * allocator_run_maintenance() every 'interval_ms' milliseconds.
+ *
+ * @return false if it is already running or cannot be created.
+ */
+bool maintenance_thread_start(unsigned interval_ms);
+
+/**
+ * @brief Wakes the thread for a pass and waits until one that started after
+ * this call has finished. The caller must hold no arena lock.
+ *
+ * @return false if the thread is not running or stopped meanwhile.
+ */
+bool maintenance_thread_request_pass(void);
+
+/**
+ * @brief Stops the thread, waits for its current pass to finish, then
+ * deactivates the caches.
+ *
+ * @return false if it was not running.
+ */
+bool maintenance_thread_stop(void);
+
+#endif // HEAP_MAINTENANCE_H
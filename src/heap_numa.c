@@ -0,0 +1,63 @@
+/**
+ * @file heap_numa.c
+ * @brief NUMA topology helpers built on raw syscalls.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#define _GNU_SOURCE
+#include "heap_numa.h"
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define MPOL_BIND 2 ///< From <linux/mempolicy.h>
+
+static _Thread_local int cached_node = -1;
+static _Thread_local unsigned calls_until_refresh = 0;
+
+int numa_node_count(void) {
+#if HEAP_NUMA_NODES > 0
+    return HEAP_NUMA_NODES;
+#else
+    // "0", "0-1", "0-3,5"... the highest listed node decides the count.
+    FILE *online = fopen("/sys/devices/system/node/online", "r");
+    if (online == NULL) {
+        return 1;
+    }
+
+    int highest = 0;
+    int value = 0;
+    int c;
+    while ((c = fgetc(online)) != EOF) {
+        if (c >= '0' && c <= '9') {
+            value = value * 10 + (c - '0');
+        } else {
+            highest = value > highest ? value : highest;
+            value = 0;
+        }
+    }
+    highest = value > highest ? value : highest;
+    fclose(online);
+
+    return highest + 1;
+#endif
+}
+
+int numa_current_node(void) {
+    if (calls_until_refresh-- == 0) {
+        unsigned cpu = 0;
+        unsigned node = 0;
+        cached_node =
+            syscall(SYS_getcpu, &cpu, &node, NULL) == 0 ? (int) node : 0;
+        calls_until_refresh = HEAP_NUMA_REFRESH;
+    }
+    return cached_node;
+}
+
+bool numa_bind(void *addr, size_t len, int node) {
+    unsigned long nodemask = 1UL << node;
+    return syscall(SYS_mbind, addr, len, MPOL_BIND, &nodemask,
+                   sizeof(nodemask) * 8, 0) == 0;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file heap_numa.h
+ * @brief Internal NUMA topology helpers (raw syscalls, no libnuma).
+ *
+ * Only built when HEAP_NUMA is enabled.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_NUMA_H
+#define HEAP_NUMA_H
+
+#include "my_allocator.h"
+
+/**
+ * @brief Number of NUMA nodes to create heaps for.
+ *
+ * Uses HEAP_NUMA_NODES when it is non-zero, otherwise the online nodes
+ * listed in sysfs. Always at least 1.
+ */
+int numa_node_count(void);
+
+/**
+ * @brief Node of the CPU the calling thread runs on.
+ *
+ * Cached per thread and refreshed every HEAP_NUMA_REFRESH calls, since
+ * threads may migrate. Returns 0 if the node cannot be determined.
+ */
+int numa_current_node(void);
+
+/**
+ * @brief Binds the pages of [addr, addr + len) to 'node'.
+ *
+ * @return true on success, false if the kernel refused the policy (e.g.
+ * the node does not exist or mbind is not permitted).
+ */
+bool numa_bind(void *addr, size_t len, int node);
+
+#endif // HEAP_NUMA_H
@@ -0,0 +1,235 @@
+/**
+ * @file heap_profiler.c
+ * @brief Sampling heap profiler with call-stack attribution.
+ *
+ * Sampled allocations are kept in a fixed-size open-addressing table keyed
+ * by user pointer, so the profiler never allocates from the heap it is
+ * profiling. The table is dumped in the legacy pprof heap format
+ * ("heap_v2"), which `pprof` un-samples using the recorded sample period.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_profiler.h"
+#include <execinfo.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/** @brief One live sampled allocation. */
+typedef struct {
+    const void *ptr; ///< User pointer, or NULL for an empty entry.
+    size_t size;     ///< Requested size in bytes.
+    int depth;       ///< Number of frames in 'stack'.
+    void *stack[HEAP_PROFILER_MAX_DEPTH]; ///< Return addresses.
+} ProfileSample;
+
+_Thread_local int64_t profiler_bytes_until_sample =
+    HEAP_PROFILER_SAMPLE_PERIOD;
+
+static _Thread_local uint64_t rng_state = 0;
+
+static size_t sample_period = HEAP_PROFILER_SAMPLE_PERIOD;
+
+static ProfileSample table[HEAP_PROFILER_MAX_SAMPLES];
+static HeapProfileStats stats;
+
+/** @brief Guards the table; only taken on the (rare) sampled paths. */
+static atomic_flag table_lock = ATOMIC_FLAG_INIT;
+
+static void lock_table(void) {
+    while (atomic_flag_test_and_set_explicit(&table_lock,
+                                             memory_order_acquire)) {
+    }
+}
+
+static void unlock_table(void) {
+    atomic_flag_clear_explicit(&table_lock, memory_order_release);
+}
+
+/**
+ * @brief Draws the next sampling interval, exponentially distributed with
+ * mean 'sample_period', so samples form a Poisson process over bytes.
+ */
+static int64_t next_interval(void) {
+    if (sample_period <= 1) {
+        return 0; // Sample everything.
+    }
+
+    if (rng_state == 0) {
+        rng_state = (uint64_t) (uintptr_t) &rng_state ^
+                    (uint64_t) time(NULL) ^ 0x9E3779B97F4A7C15ULL;
+    }
+
+    // xorshift64, then map the top 53 bits to (0, 1].
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    double u = (double) ((rng_state >> 11) + 1) * (1.0 / 9007199254740992.0);
+
+    return (int64_t) (-log(u) * (double) sample_period);
+}
+
+/**
+ * @brief Home slot of 'ptr' in the table.
+ */
+static size_t slot_of(const void *ptr) {
+    uint64_t key = (uint64_t) (uintptr_t) ptr;
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    return (size_t) (key % HEAP_PROFILER_MAX_SAMPLES);
+}
+
+void profiler_record(void *ptr, size_t size) {
+    profiler_bytes_until_sample = next_interval();
+
+    ProfileSample sample;
+    sample.ptr = ptr;
+    sample.size = size;
+    sample.depth = backtrace(sample.stack, HEAP_PROFILER_MAX_DEPTH);
+
+    lock_table();
+    if (stats.live_samples == HEAP_PROFILER_MAX_SAMPLES) {
+        stats.dropped_samples++;
+        unlock_table();
+        return;
+    }
+
+    size_t slot = slot_of(ptr);
+    while (table[slot].ptr != NULL) {
+        slot = (slot + 1) % HEAP_PROFILER_MAX_SAMPLES;
+    }
+    table[slot] = sample;
+    stats.live_samples++;
+    stats.live_bytes += size;
+    unlock_table();
+}
+
+void profiler_forget(const void *ptr) {
+    lock_table();
+
+    size_t slot = slot_of(ptr);
+    for (size_t probes = 0; probes < HEAP_PROFILER_MAX_SAMPLES; probes++) {
+        if (table[slot].ptr == NULL) {
+            break; // Not sampled.
+        }
+        if (table[slot].ptr != ptr) {
+            slot = (slot + 1) % HEAP_PROFILER_MAX_SAMPLES;
+            continue;
+        }
+
+        stats.live_samples--;
+        stats.live_bytes -= table[slot].size;
+
+        // Backward-shift deletion keeps every probe chain unbroken.
+        size_t hole = slot;
+        size_t next = (hole + 1) % HEAP_PROFILER_MAX_SAMPLES;
+        while (table[next].ptr != NULL) {
+            size_t home = slot_of(table[next].ptr);
+            size_t dist_next = (next + HEAP_PROFILER_MAX_SAMPLES - home) %
+                               HEAP_PROFILER_MAX_SAMPLES;
+            size_t dist_hole = (hole + HEAP_PROFILER_MAX_SAMPLES - home) %
+                               HEAP_PROFILER_MAX_SAMPLES;
+            if (dist_hole < dist_next) {
+                table[hole] = table[next];
+                hole = next;
+            }
+            next = (next + 1) % HEAP_PROFILER_MAX_SAMPLES;
+        }
+        table[hole].ptr = NULL;
+        break;
+    }
+
+    unlock_table();
+}
+
+void profiler_reset(void) {
+    lock_table();
+    memset(table, 0, sizeof(table));
+    memset(&stats, 0, sizeof(stats));
+    unlock_table();
+}
+
+void allocator_set_profile_sample_period(size_t bytes) {
+    sample_period = bytes;
+    profiler_bytes_until_sample = next_interval();
+}
+
+void allocator_get_profile_stats(HeapProfileStats *out) {
+    if (out == NULL) {
+        return;
+    }
+    lock_table();
+    *out = stats;
+    unlock_table();
+}
+
+/**
+ * @brief Checks whether two samples were taken from the same call stack.
+ */
+static bool same_stack(const ProfileSample *a, const ProfileSample *b) {
+    return a->depth == b->depth &&
+           memcmp(a->stack, b->stack, (size_t) a->depth * sizeof(void *)) ==
+               0;
+}
+
+int allocator_dump_profile(FILE *out) {
+    if (out == NULL) {
+        return -1;
+    }
+
+    lock_table();
+
+    fprintf(out, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n",
+            stats.live_samples, stats.live_bytes, stats.live_samples,
+            stats.live_bytes, sample_period);
+
+    // One line per distinct stack: the first entry of each stack in table
+    // order aggregates every later entry with the same stack.
+    for (size_t i = 0; i < HEAP_PROFILER_MAX_SAMPLES; i++) {
+        if (table[i].ptr == NULL) {
+            continue;
+        }
+
+        bool seen = false;
+        for (size_t j = 0; j < i && !seen; j++) {
+            seen = table[j].ptr != NULL && same_stack(&table[i], &table[j]);
+        }
+        if (seen) {
+            continue;
+        }
+
+        size_t count = 0;
+        size_t bytes = 0;
+        for (size_t j = i; j < HEAP_PROFILER_MAX_SAMPLES; j++) {
+            if (table[j].ptr != NULL && same_stack(&table[i], &table[j])) {
+                count++;
+                bytes += table[j].size;
+            }
+        }
+
+        fprintf(out, "%zu: %zu [%zu: %zu] @", count, bytes, count, bytes);
+        for (int frame = 0; frame < table[i].depth; frame++) {
+            fprintf(out, " %p", table[i].stack[frame]);
+        }
+        fputc('\n', out);
+    }
+
+    unlock_table();
+
+    // pprof symbolizes addresses using the process mappings.
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps != NULL) {
+        char line[512];
+        fputs("\nMAPPED_LIBRARIES:\n", out);
+        while (fgets(line, sizeof(line), maps) != NULL) {
+            fputs(line, out);
+        }
+        fclose(maps);
+    }
+
+    return ferror(out) ? -1 : 0;
+}
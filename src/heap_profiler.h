@@ -0,0 +1,52 @@
+/**
+ * @file heap_profiler.h
+ * @brief Internal interface of the sampling heap profiler.
+ *
+ * Only built when HEAP_PROFILER is enabled. Each thread counts down the
+ * bytes it allocates; when the counter drops below zero the allocation is
+ * sampled, its backtrace recorded and a new exponentially distributed
+ * interval drawn, so on average one sample is taken per sample period.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+
+#include "my_allocator.h"
+
+/** @brief Bytes the current thread may allocate before the next sample. */
+extern _Thread_local int64_t profiler_bytes_until_sample;
+
+/**
+ * @brief Charges 'size' bytes to the sampling counter.
+ *
+ * This is the whole cost of an unsampled allocation.
+ *
+ * @return true if the allocation must be passed to profiler_record().
+ */
+static inline bool profiler_should_sample(size_t size) {
+    profiler_bytes_until_sample -= (int64_t) size;
+    return profiler_bytes_until_sample < 0;
+}
+
+/**
+ * @brief Records a sampled allocation and draws the next sample interval.
+ *
+ * @param ptr User pointer of the allocation.
+ * @param size Requested size in bytes.
+ */
+void profiler_record(void *ptr, size_t size);
+
+/**
+ * @brief Removes a sampled allocation from the live table, if present.
+ */
+void profiler_forget(const void *ptr);
+
+/**
+ * @brief Drops all live samples (allocator_init()).
+ */
+void profiler_reset(void);
+
+#endif // HEAP_PROFILER_H
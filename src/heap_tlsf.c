@@ -0,0 +1,232 @@
+/**
+ * @file heap_tlsf.c
+ * @brief Two-Level Segregated Fit: constant-time malloc and free.
+ *
+ * Size classes: data sizes below 128 bytes map to first level 0, split into
+ * 8-byte second-level ranges. Above, first level 'fl' holds the sizes in
+ * [2^(fl + 6), 2^(fl + 7)), split into TLSF_SL_COUNT equal ranges. A block
+ * is filed under the class containing its size; a request is rounded up to
+ * the next class boundary first, so any block of the class found serves it
+ * (good fit instead of best fit, as in the original TLSF).
+ *
+ * Steps counts the constant-time units of work: one per bitmap word
+ * searched, one per free-list unlink or insert and one per merge.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_tlsf.h"
+
+#define SMALL_SHIFT 7 ///< log2 of the first size with a first level above 0
+#define SMALL_LIMIT ((size_t) 1 << SMALL_SHIFT)
+#define SMALL_STEP (SMALL_LIMIT / TLSF_SL_COUNT) ///< Width of a small class
+
+/** @brief Smallest remainder worth splitting off as a free block. */
+#define MIN_SPLIT (sizeof(BlockHeader) + ALIGNMENT)
+
+static BlockHeader *block_at(char *base, size_t offset) {
+    return offset == BLOCK_NONE ? NULL : (BlockHeader *) (base + offset);
+}
+
+static size_t offset_of(const char *base, const BlockHeader *block) {
+    return (size_t) ((const char *) block - base);
+}
+
+/** @brief Block right after 'block' in memory, or NULL at the arena end. */
+static BlockHeader *phys_next(char *base, size_t arena_size,
+                              BlockHeader *block) {
+    char *next = (char *) (block + 1) + block->size;
+    return (size_t) (next - base) < arena_size ? (BlockHeader *) next : NULL;
+}
+
+/**
+ * @brief Class a free block of 'size' bytes is filed under.
+ *
+ * Blocks too large for the last first level share its last list.
+ */
+static void mapping_insert(size_t size, unsigned *fl, unsigned *sl) {
+    if (size < SMALL_LIMIT) {
+        *fl = 0;
+        *sl = (unsigned) (size / SMALL_STEP);
+        return;
+    }
+    unsigned magnitude = 63 - (unsigned) __builtin_clzll(size);
+    *fl = magnitude - (SMALL_SHIFT - 1);
+    *sl = (unsigned) (size >> (magnitude - TLSF_SL_BITS)) - TLSF_SL_COUNT;
+    if (*fl >= HEAP_TLSF_FL_COUNT) {
+        *fl = HEAP_TLSF_FL_COUNT - 1;
+        *sl = TLSF_SL_COUNT - 1;
+    }
+}
+
+/**
+ * @brief First class whose every block holds 'size' bytes.
+ *
+ * @return false if 'size' is beyond the last class.
+ */
+static bool mapping_search(size_t size, unsigned *fl, unsigned *sl) {
+    if (size >= SMALL_LIMIT) {
+        unsigned magnitude = 63 - (unsigned) __builtin_clzll(size);
+        size_t round = ((size_t) 1 << (magnitude - TLSF_SL_BITS)) - 1;
+        if (size > SIZE_MAX - round) {
+            return false;
+        }
+        size += round;
+    }
+    // Clamping to the last list would hand out blocks that are too small.
+    if (size >= (size_t) 1 << (HEAP_TLSF_FL_COUNT + SMALL_SHIFT - 1)) {
+        return false;
+    }
+    mapping_insert(size, fl, sl);
+    return true;
+}
+
+static void insert_free(TlsfControl *tlsf, char *base, BlockHeader *block) {
+    unsigned fl;
+    unsigned sl;
+    mapping_insert(block->size, &fl, &sl);
+
+    BlockHeader *head = block_at(base, tlsf->heads[fl][sl]);
+    block->is_free = true;
+    block->next = tlsf->heads[fl][sl];
+    block->prev_free = BLOCK_NONE;
+    if (head != NULL) {
+        head->prev_free = offset_of(base, block);
+    }
+    tlsf->heads[fl][sl] = offset_of(base, block);
+    tlsf->fl_bitmap |= 1u << fl;
+    tlsf->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void remove_free(TlsfControl *tlsf, char *base, BlockHeader *block) {
+    unsigned fl;
+    unsigned sl;
+    mapping_insert(block->size, &fl, &sl);
+
+    BlockHeader *prev = block_at(base, block->prev_free);
+    BlockHeader *next = block_at(base, block->next);
+    if (next != NULL) {
+        next->prev_free = block->prev_free;
+    }
+    if (prev != NULL) {
+        prev->next = block->next;
+    } else {
+        tlsf->heads[fl][sl] = block->next;
+        if (block->next == BLOCK_NONE) {
+            tlsf->sl_bitmap[fl] &= ~(1u << sl);
+            if (tlsf->sl_bitmap[fl] == 0) {
+                tlsf->fl_bitmap &= ~(1u << fl);
+            }
+        }
+    }
+    block->is_free = false;
+    block->next = BLOCK_NONE;
+    block->prev_free = BLOCK_NONE;
+}
+
+void tlsf_reset(TlsfControl *tlsf, char *base, size_t size) {
+    tlsf->fl_bitmap = 0;
+    for (size_t fl = 0; fl < HEAP_TLSF_FL_COUNT; fl++) {
+        tlsf->sl_bitmap[fl] = 0;
+        for (size_t sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            tlsf->heads[fl][sl] = BLOCK_NONE;
+        }
+    }
+    tlsf->max_malloc_steps = 0;
+    tlsf->max_free_steps = 0;
+
+    if (base == NULL || size < MIN_SPLIT) {
+        return;
+    }
+
+    BlockHeader *first = (BlockHeader *) base;
+    first->size = size - sizeof(BlockHeader);
+    first->flags = 0;
+    first->magic = BLOCK_MAGIC;
+    first->prev_phys = BLOCK_NONE;
+    insert_free(tlsf, base, first);
+}
+
+BlockHeader *tlsf_malloc(TlsfControl *tlsf, char *base, size_t arena_size,
+                         size_t size) {
+    unsigned fl;
+    unsigned sl;
+    size_t steps = 1;
+    if (!mapping_search(size, &fl, &sl)) {
+        return NULL;
+    }
+
+    // A large enough list in the same first level, or else the smallest
+    // non-empty list of a higher one.
+    uint32_t sl_map = tlsf->sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map =
+            fl + 1 < 32 ? tlsf->fl_bitmap & (~0u << (fl + 1)) : 0;
+        steps++;
+        if (fl_map == 0) {
+            return NULL;
+        }
+        fl = (unsigned) __builtin_ctz(fl_map);
+        sl_map = tlsf->sl_bitmap[fl];
+        steps++;
+    }
+    sl = (unsigned) __builtin_ctz(sl_map);
+
+    BlockHeader *block = block_at(base, tlsf->heads[fl][sl]);
+    remove_free(tlsf, base, block);
+    steps++;
+
+    if (block->size - size >= MIN_SPLIT) {
+        BlockHeader *rest = (BlockHeader *) ((char *) (block + 1) + size);
+        rest->size = block->size - size - sizeof(BlockHeader);
+        rest->flags = 0;
+        rest->magic = BLOCK_MAGIC;
+        rest->prev_phys = offset_of(base, block);
+        BlockHeader *after = phys_next(base, arena_size, rest);
+        if (after != NULL) {
+            after->prev_phys = offset_of(base, rest);
+        }
+        block->size = size;
+        insert_free(tlsf, base, rest);
+        steps++;
+    }
+
+    if (steps > tlsf->max_malloc_steps) {
+        tlsf->max_malloc_steps = steps;
+    }
+    return block;
+}
+
+void tlsf_free(TlsfControl *tlsf, char *base, size_t arena_size,
+               BlockHeader *block) {
+    size_t steps = 1;
+    // Headers absorbed by a merge stay marked free, so a second free of
+    // their pointers is still reported.
+    block->is_free = true;
+
+    BlockHeader *prev = block_at(base, block->prev_phys);
+    if (prev != NULL && prev->is_free) {
+        remove_free(tlsf, base, prev);
+        prev->size += sizeof(BlockHeader) + block->size;
+        block = prev;
+        steps++;
+    }
+
+    BlockHeader *next = phys_next(base, arena_size, block);
+    if (next != NULL && next->is_free) {
+        remove_free(tlsf, base, next);
+        next->is_free = true;
+        block->size += sizeof(BlockHeader) + next->size;
+        next = phys_next(base, arena_size, block);
+        steps++;
+    }
+    if (next != NULL) {
+        next->prev_phys = offset_of(base, block);
+    }
+
+    insert_free(tlsf, base, block);
+    if (steps > tlsf->max_free_steps) {
+        tlsf->max_free_steps = steps;
+    }
+}
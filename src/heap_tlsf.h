@@ -0,0 +1,61 @@
+/**
+ * @file heap_tlsf.h
+ * @brief Internal interface of the Two-Level Segregated Fit policy.
+ *
+ * Only built when HEAP_POLICY is HEAP_POLICY_TLSF. Free blocks are kept in
+ * segregated lists: the first level splits sizes by power of two, the
+ * second level splits each power of two into TLSF_SL_COUNT linear ranges.
+ * One bitmap per level records the non-empty lists, so finding a list
+ * with a large enough block takes two find-first-set operations. Blocks
+ * carry their physical predecessor, so free merges with both neighbours in
+ * constant time. No operation loops over blocks.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#ifndef HEAP_TLSF_H
+#define HEAP_TLSF_H
+
+#include "my_allocator.h"
+
+#define TLSF_SL_BITS 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_BITS) ///< Second-level lists per class
+
+/**
+ * @brief Free-list heads and bitmaps of one arena.
+ */
+typedef struct {
+    uint32_t fl_bitmap;                      ///< Non-empty first levels
+    uint32_t sl_bitmap[HEAP_TLSF_FL_COUNT]; ///< Non-empty lists per level
+    /** @brief Offset of the first block of each list, or BLOCK_NONE. */
+    size_t heads[HEAP_TLSF_FL_COUNT][TLSF_SL_COUNT];
+    size_t max_malloc_steps; ///< Most steps taken by one malloc
+    size_t max_free_steps;   ///< Most steps taken by one free
+} TlsfControl;
+
+/**
+ * @brief Formats 'size' bytes at 'base' as one free block.
+ *
+ * With no usable region, leaves every list empty.
+ */
+void tlsf_reset(TlsfControl *tlsf, char *base, size_t size);
+
+/**
+ * @brief Takes a block of at least 'size' data bytes out of the free lists,
+ * splitting off and keeping the rest.
+ *
+ * @param base First byte of the arena.
+ * @param arena_size Size of the arena in bytes.
+ * @return The allocated block, or NULL if no block is large enough.
+ */
+BlockHeader *tlsf_malloc(TlsfControl *tlsf, char *base, size_t arena_size,
+                         size_t size);
+
+/**
+ * @brief Returns an allocated block, merging it with free neighbours.
+ */
+void tlsf_free(TlsfControl *tlsf, char *base, size_t arena_size,
+               BlockHeader *block);
+
+#endif // HEAP_TLSF_H
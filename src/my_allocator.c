@@ -16,67 +16,492 @@
 #include <stdio.h>
 #include <string.h>
 
+#if HEAP_DEBUG_GUARD
+#include "heap_guard.h"
+#endif
+
+#if HEAP_PROFILER
+#include "heap_profiler.h"
+#endif
+
+#if HEAP_NUMA
+#include "heap_numa.h"
+#include <stdatomic.h>
+#endif
+
+#if HEAP_THREAD_SAFE
+#include <errno.h>
+#include <pthread.h>
+#endif
+
+#if HEAP_MAPPED_BACKEND
+#include "heap_file.h"
+#include <sys/mman.h>
+#endif
+
+#if HEAP_FREE_INDEX
+#include "heap_free_index.h"
+#endif
+
+#if HEAP_LATENCY
+#include "heap_latency.h"
+#endif
+
+#if HEAP_BUDGETS
+#include "heap_budget.h"
+#endif
+
+#if HEAP_MAINTENANCE
+#include "heap_maintenance.h"
+#endif
+
+#if HEAP_ISOLATION
+#include "heap_isolation.h"
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+#include "heap_tlsf.h"
+#elif HEAP_POLICY == HEAP_POLICY_BUDDY
+#include "heap_buddy.h"
+#endif
+
 // --- V2.0: Global Heap State ---
 #if HEAP_BACKEND == HEAP_BACKEND_STATIC
-
-__attribute__((section(".my_heap"))) // Force heap to be in .my_heap section
+__attribute__((section(".my_heap"),
+               aligned(ALIGNMENT))) // Force heap to be in .my_heap section
 static char heap[HEAP_SIZE];
-static size_t heap_size = HEAP_SIZE;
-#elif HEAP_BACKEND == HEAP_BACKEND_SBRK
-static char *heap = NULL;
-static size_t heap_size = 0;
-#elif HEAP_BACKEND == HEAP_BACKEND_MMAP
-static char *heap = NULL;
-static size_t heap_size = 0;
 #endif
 
-/** @brief Pointer to the first block in the singly-linked explicit free list.
+#if HEAP_NUMA
+#define HEAP_MAX_ARENAS HEAP_NUMA_MAX_NODES ///< One arena per NUMA node.
+#elif HEAP_REGIONS
+#define HEAP_MAX_ARENAS HEAP_MAX_REGIONS ///< One arena per memory region.
+#else
+#define HEAP_MAX_ARENAS 1
+#endif
+
+/**
+ * @brief A contiguous heap region with its own explicit free list.
+ *
+ * The backend heap is arena 0. NUMA mode adds one arena per node; region
+ * mode has one per region, in the order they are tried.
+ */
+typedef struct {
+    char *base;  ///< First byte of the region
+    size_t size; ///< Size of the region in bytes
+    /** @brief Where the offset of the first free block is stored. */
+    size_t *free_list_head;
+    size_t local_head; ///< Head storage for arenas not backed by a file
+    size_t hot_floor;  ///< Offset of the lowest block of the hot run
+#if HEAP_THREAD_SAFE
+    /** @brief Protects the free list and block headers. */
+    pthread_mutex_t *lock;
+    pthread_mutex_t local_lock; ///< Lock for arenas not shared by processes
+    bool lock_ready;            ///< Whether 'local_lock' has been initialized
+#endif
+#if HEAP_FREE_INDEX
+    FreeIndex index; ///< Searchable copy of the free list
+#endif
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+    TlsfControl tlsf; ///< Segregated free lists replacing the free list
+#elif HEAP_POLICY == HEAP_POLICY_BUDDY
+    BuddyControl buddy; ///< Per-order free lists replacing the free list
+#endif
+#if HEAP_MAINTENANCE
+    MaintenanceCache cache; ///< Per-size caches of the maintenance thread
+#endif
+#if HEAP_REGIONS
+    unsigned attrs;    ///< HEAP_REGION_* bits of the region
+    unsigned priority; ///< Priority of the region
+    int region;        ///< Index of the region in its registration array
+#endif
+} HeapArena;
+
+static HeapArena arenas[HEAP_MAX_ARENAS];
+static size_t arena_count = 0;
+
+#if HEAP_REGIONS
+/** @brief The live arenas sorted by base address, for arena_of(). */
+static HeapArena *arenas_by_address[HEAP_MAX_ARENAS];
+#endif
+
+#if HEAP_MAPPED_BACKEND
+static HeapFileHeader *heap_file = NULL; ///< Current mapping, or NULL
+#endif
+
+#if HEAP_THREAD_SAFE
+/**
+ * @brief Locks 'arena', recovering the lock if its owner died.
+ *
+ * Only process-shared locks are robust. If another process died while
+ * holding one, its last free-list update may be incomplete; the heap is
+ * still used, as the alternative is to wedge every other process.
+ */
+static void arena_lock(HeapArena *arena) {
+    if (pthread_mutex_lock(arena->lock) == EOWNERDEAD) {
+        fprintf(stderr, "Warning: heap lock owner died; recovering.\n");
+        pthread_mutex_consistent(arena->lock);
+    }
+}
+
+#define ARENA_LOCK(arena) arena_lock(arena)
+#define ARENA_UNLOCK(arena) pthread_mutex_unlock((arena)->lock)
+#else
+#define ARENA_LOCK(arena) ((void) 0)
+#define ARENA_UNLOCK(arena) ((void) 0)
+#endif
+
+#if HEAP_CHECKPOINT
+/**
+ * @brief Undo record: the bytes at 'addr' before a metadata write.
+ */
+typedef struct {
+    void *addr;                              ///< Header or list head written
+    size_t len;                              ///< Number of bytes saved
+    unsigned char old[sizeof(BlockHeader)]; ///< Previous contents
+} JournalEntry;
+
+static JournalEntry journal[HEAP_JOURNAL_CAPACITY];
+static size_t journal_len = 0;
+static bool journal_active = false;     ///< A checkpoint is outstanding
+static size_t journal_open = 0;         ///< Checkpoints not yet finished
+static bool journal_overflowed = false; ///< Entries were lost
+static uint32_t journal_generation = 0; ///< Bumped by allocator_init()
+
+/**
+ * @brief Saves 'len' bytes at 'addr' before they are overwritten.
  */
-static BlockHeader *free_list_head = NULL;
+static void journal_save(void *addr, size_t len) {
+    if (journal_len == HEAP_JOURNAL_CAPACITY) {
+        // Older checkpoints can no longer be restored; stop paying for it.
+        journal_overflowed = true;
+        journal_active = false;
+        return;
+    }
+    journal[journal_len].addr = addr;
+    journal[journal_len].len = len;
+    memcpy(journal[journal_len].old, addr, len);
+    journal_len++;
+}
+
+#define JOURNAL_BLOCK(block)                                                   \
+    do {                                                                       \
+        if (journal_active) {                                                  \
+            journal_save((block), sizeof(BlockHeader));                        \
+        }                                                                      \
+    } while (0)
+#define JOURNAL_HEAD(arena)                                                    \
+    do {                                                                       \
+        if (journal_active) {                                                  \
+            journal_save((arena)->free_list_head, sizeof(size_t));             \
+        }                                                                      \
+    } while (0)
+#else
+#define JOURNAL_BLOCK(block) ((void) 0)
+#define JOURNAL_HEAD(arena) ((void) 0)
+#endif
+
+#if HEAP_LATENCY
+// Public entry points are timed as a whole; free blocks examined on the way
+// are counted for the malloc histogram.
+#define LATENCY_BEGIN() uint64_t latency_start = latency_enter()
+#define LATENCY_END(op) latency_leave((op), latency_start)
+#define LATENCY_WALK(n) (latency_walk += (n))
+#else
+#define LATENCY_BEGIN() ((void) 0)
+#define LATENCY_END(op) ((void) 0)
+#define LATENCY_WALK(n) ((void) 0)
+#endif
+
+#if HEAP_FREE_INDEX
+// Every free-list update is mirrored in the index. Updates the index cannot
+// follow cheaply invalidate it, and the next search rebuilds it.
+#define INDEX_PUSH(arena, block)                                               \
+    free_index_push(&(arena)->index, (arena)->base,                            \
+                    block_offset((arena), (block)), (block)->size)
+#define INDEX_REMOVE(arena, block)                                             \
+    free_index_remove(&(arena)->index, (arena)->base,                          \
+                      block_offset((arena), (block)))
+#define INDEX_REPLACE(arena, old_block, block)                                 \
+    free_index_replace(&(arena)->index, (arena)->base,                         \
+                       block_offset((arena), (old_block)),                     \
+                       block_offset((arena), (block)), (block)->size)
+#define INDEX_RESIZE(arena, block)                                             \
+    free_index_resize(&(arena)->index, (arena)->base,                          \
+                      block_offset((arena), (block)), (block)->size)
+#define INDEX_INVALIDATE(arena) ((arena)->index.valid = false)
+#else
+#define INDEX_PUSH(arena, block) ((void) 0)
+#define INDEX_REMOVE(arena, block) ((void) 0)
+#define INDEX_REPLACE(arena, old_block, block) ((void) 0)
+#define INDEX_RESIZE(arena, block) ((void) 0)
+#define INDEX_INVALIDATE(arena) ((void) 0)
+#endif
+
+#if HEAP_HANDLES
+/** @brief Master pointers; an HHandle points at one of these. */
+static void *handle_table[HEAP_HANDLE_SLOTS];
+static unsigned handle_locks[HEAP_HANDLE_SLOTS]; ///< hlock() nesting depth
+
+#if HEAP_THREAD_SAFE
+/** @brief Protects the handle table. Taken before any arena lock. */
+static pthread_mutex_t handle_lock = PTHREAD_MUTEX_INITIALIZER;
+#define HANDLES_LOCK() pthread_mutex_lock(&handle_lock)
+#define HANDLES_UNLOCK() pthread_mutex_unlock(&handle_lock)
+#else
+#define HANDLES_LOCK() ((void) 0)
+#define HANDLES_UNLOCK() ((void) 0)
+#endif
+#endif
+
+#if HEAP_NUMA
+static atomic_size_t numa_local_allocations;
+static atomic_size_t numa_remote_allocations;
+static atomic_size_t numa_cross_node_frees;
+static size_t numa_bind_failures;
+#endif
+
+// Block headers sit at ALIGNMENT boundaries and every block data area is a
+// multiple of ALIGNMENT, so user data always starts MY_ALLOC_PREFIX_SIZE
+// bytes after the header.
+_Static_assert(sizeof(BlockHeader) % ALIGNMENT == 0,
+               "BlockHeader size must be a multiple of ALIGNMENT");
 
 // --- Helper Functions ---
 
 /**
- * @brief Checks if the given pointer is within the heap.
+ * @brief Checks if the given pointer is within an arena.
  *
+ * @param arena Arena to check against.
  * @param ptr Pointer to validate.
- * @return int Non-zero if the pointer is within the heap, zero otherwise.
+ * @return int Non-zero if the pointer is within the arena, zero otherwise.
  */
-static int is_within_heap(const void *ptr) {
+static int is_within_heap(const HeapArena *arena, const void *ptr) {
     // Check if the pointer is within the heap.
-    if (ptr == NULL) {
+    if (ptr == NULL || arena->base == NULL) {
         return 0;
     }
 
-#if HEAP_BACKEND == HEAP_BACKEND_SBRK || HEAP_BACKEND == HEAP_BACKEND_MMAP
-    if (heap == NULL) {
-        return 0;
+    const char *cptr = (const char *) ptr;
+    return cptr >= arena->base && cptr < (arena->base + arena->size);
+}
+
+/**
+ * @brief Finds the arena that contains 'ptr'.
+ *
+ * @return HeapArena* Owning arena, or NULL if 'ptr' is outside every arena.
+ */
+static HeapArena *arena_of(const void *ptr) {
+#if HEAP_REGIONS
+    // Binary search for the last arena starting at or below 'ptr'.
+    uintptr_t addr = (uintptr_t) ptr;
+    size_t low = 0;
+    size_t high = arena_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if ((uintptr_t) arenas_by_address[mid]->base <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low > 0 && is_within_heap(arenas_by_address[low - 1], ptr)) {
+        return arenas_by_address[low - 1];
+    }
+    return NULL;
+#else
+    for (size_t i = 0; i < arena_count; i++) {
+        if (is_within_heap(&arenas[i], ptr)) {
+            return &arenas[i];
+        }
     }
+    return NULL;
 #endif
+}
 
-    const char *cptr = (const char *) ptr;
-    return cptr >= heap && cptr < (heap + heap_size);
+#if HEAP_POLICY == HEAP_POLICY_FIRST_FIT
+// Free-list links are offsets from the arena base, so a heap stays valid
+// wherever it is mapped.
+
+/** @brief Converts a free-list offset into a block pointer. */
+static BlockHeader *block_at(const HeapArena *arena, size_t offset) {
+    return offset == BLOCK_NONE ? NULL : (BlockHeader *) (arena->base + offset);
+}
+
+/** @brief Converts a block pointer into a free-list offset. */
+static size_t block_offset(const HeapArena *arena, const BlockHeader *block) {
+    return block == NULL ? BLOCK_NONE
+                         : (size_t) ((const char *) block - arena->base);
+}
+
+/** @brief First block of the free list. */
+static BlockHeader *list_head(const HeapArena *arena) {
+    return block_at(arena, *arena->free_list_head);
+}
+
+static void set_list_head(HeapArena *arena, const BlockHeader *block) {
+    *arena->free_list_head = block_offset(arena, block);
+}
+
+/** @brief Block following 'block' in the free list. */
+static BlockHeader *list_next(const HeapArena *arena,
+                              const BlockHeader *block) {
+    return block_at(arena, block->next);
+}
+
+static void set_list_next(const HeapArena *arena, BlockHeader *block,
+                          const BlockHeader *next) {
+    block->next = block_offset(arena, next);
+}
+#endif
+
+/**
+ * @brief Turns a region into an arena holding a single free block.
+ *
+ * @param arena Arena to (re)initialize.
+ * @param base First byte of the region, aligned to ALIGNMENT.
+ * @param size Size of the region in bytes.
+ */
+static void arena_reset(HeapArena *arena, char *base, size_t size) {
+#if HEAP_THREAD_SAFE
+    if (!arena->lock_ready) {
+        pthread_mutex_init(&arena->local_lock, NULL);
+        arena->lock_ready = true;
+    }
+    if (arena->lock == NULL) {
+        arena->lock = &arena->local_lock;
+    }
+#endif
+
+    arena->base = base;
+    arena->size = size & ~(size_t) (ALIGNMENT - 1);
+    if (arena->free_list_head == NULL) {
+        arena->free_list_head = &arena->local_head;
+    }
+    *arena->free_list_head = BLOCK_NONE;
+    arena->hot_floor = BLOCK_NONE;
+#if HEAP_FREE_INDEX
+    free_index_reset(&arena->index);
+#endif
+#if HEAP_MAINTENANCE
+    memset(&arena->cache, 0, sizeof(arena->cache));
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+    tlsf_reset(&arena->tlsf, base, base == NULL ? 0 : arena->size);
+#elif HEAP_POLICY == HEAP_POLICY_BUDDY
+    buddy_reset(&arena->buddy, base, base == NULL ? 0 : arena->size);
+#else
+    if (base == NULL || arena->size <= sizeof(BlockHeader)) {
+        return;
+    }
+
+    // Setup free list.
+    BlockHeader *first = (BlockHeader *) base;
+    first->size = arena->size - sizeof(BlockHeader);
+    first->is_free = true;
+    first->flags = 0;
+    first->next = BLOCK_NONE;
+    first->magic = BLOCK_MAGIC;
+    set_list_head(arena, first);
+    INDEX_PUSH(arena, first);
+#endif
+}
+
+#if HEAP_POLICY == HEAP_POLICY_FIRST_FIT
+#if HEAP_FREE_INDEX
+/**
+ * @brief Reads the free list into the index, unless the list is too long.
+ *
+ * After a failed attempt the next few searches just walk the list, so an
+ * overlong list does not cost two walks per search.
+ */
+static void index_rebuild(HeapArena *arena) {
+    FreeIndex *index = &arena->index;
+    if (index->rebuild_backoff > 0) {
+        index->rebuild_backoff--;
+        return;
+    }
+
+    size_t count = 0;
+    for (const BlockHeader *block = list_head(arena);
+         block != NULL && count <= FREE_INDEX_REBUILD_LIMIT;
+         block = list_next(arena, block)) {
+        count++;
+    }
+    if (!free_index_begin_fill(index, count)) {
+        index->rebuild_backoff = FREE_INDEX_REBUILD_BACKOFF;
+        return;
+    }
+
+    size_t nth = 0;
+    for (const BlockHeader *block = list_head(arena); block != NULL;
+         block = list_next(arena, block)) {
+        free_index_fill(index, arena->base, nth++, block_offset(arena, block),
+                        block->size);
+    }
 }
 
+/**
+ * @brief First fit found through the index instead of the list.
+ *
+ * Sizes of 4 GiB and more are saturated in the index, so a hit is checked
+ * against the block itself.
+ */
+static BlockHeader *index_find(const HeapArena *arena, size_t size,
+                               BlockHeader **prev_out) {
+    const FreeIndex *index = &arena->index;
+    size_t end = index->len;
+    size_t pos;
+    while ((pos = free_index_find(index, size, end)) != FREE_INDEX_NOT_FOUND) {
+        BlockHeader *block = block_at(arena, index->offsets[pos]);
+        if (block->size >= size) {
+            *prev_out = block_at(arena, free_index_prev(index, pos));
+            LATENCY_WALK(index->len - pos);
+            return block;
+        }
+        end = pos;
+    }
+    LATENCY_WALK(index->len);
+    return NULL;
+}
+#endif
+
 /**
  * @brief Finds the first free block large enough to hold 'size' bytes.
  *
+ * @param arena Arena to search.
  * @param size Minimum required size.
  * @param prev_out A pointer to a BlockHeader pointer, which will be updated
  * to a point to the block *before* the found block(or NULL if found block is
  * the head).
  * @return Pointer to a suitable free block, or NULL if none found.
  */
-static BlockHeader *find_free_block(size_t size, BlockHeader **prev_out) {
-    BlockHeader *current = free_list_head;
+static BlockHeader *find_free_block(HeapArena *arena, size_t size,
+                                    BlockHeader **prev_out) {
     *prev_out = NULL;
 
+#if HEAP_FREE_INDEX
+    if (!arena->index.valid && !arena->index.disabled) {
+        index_rebuild(arena);
+    }
+    if (arena->index.valid) {
+        return index_find(arena, size, prev_out);
+    }
+#endif
+
+    BlockHeader *current = list_head(arena);
     while (current) {
+        // Start loading the next header while this one is checked.
+        BlockHeader *next = list_next(arena, current);
+        __builtin_prefetch(next);
+        LATENCY_WALK(1);
+
         if (current->is_free && current->size >= size) {
             return current;
         }
         *prev_out = current;
-        current = current->next;
+        current = next;
     }
     return NULL;
 }
@@ -84,11 +509,13 @@ static BlockHeader *find_free_block(size_t size, BlockHeader **prev_out) {
 /**
  * @brief Splits a free block to fit the requested size and prepare it for use.
  *
+ * @param arena Arena owning the block.
  * @param block_to_split Block to split and prepare.
  * @param requested_size Size of the requested block in bytes.
  * @param prev Previous block in the free list.
  */
-static void split_and_prepare_block(BlockHeader *block_to_split,
+static void split_and_prepare_block(HeapArena *arena,
+                                    BlockHeader *block_to_split,
                                     size_t requested_size, BlockHeader *prev) {
     // Minimum data size for a usable block after splitting.
     const size_t min_block_data_size = ALIGNMENT;
@@ -100,6 +527,14 @@ static void split_and_prepare_block(BlockHeader *block_to_split,
     size_t original_block_size =
         block_to_split->size; // Get original block size
 
+    // Both branches rewrite this header and the link pointing at it.
+    JOURNAL_BLOCK(block_to_split);
+    if (prev) {
+        JOURNAL_BLOCK(prev);
+    } else {
+        JOURNAL_HEAD(arena);
+    }
+
     // Check if splitting leaves enough space for a new free block.
     if ((original_block_size >= requested_size) &&
         (original_block_size - requested_size >= min_block_total_size)) {
@@ -110,22 +545,25 @@ static void split_and_prepare_block(BlockHeader *block_to_split,
         new_free_block->size =
             original_block_size - requested_size - sizeof(BlockHeader);
         new_free_block->is_free = true;
+        new_free_block->flags = 0;
         new_free_block->next = block_to_split->next; // Add to free list chain
         new_free_block->magic = BLOCK_MAGIC;
+        INDEX_REPLACE(arena, block_to_split, new_free_block);
 
         // Adjust original block.
         block_to_split->size = requested_size; // Update block size
         block_to_split->is_free = false;
-        block_to_split->next = NULL;         // Remove from free list chain
+        block_to_split->next = BLOCK_NONE;   // Remove from free list chain
         block_to_split->magic = BLOCK_MAGIC; // Update the magic number
 
         // Update free list links to insert new_free_block.
         if (prev) {
-            prev->next = new_free_block;
+            set_list_next(arena, prev, new_free_block);
         } else {
-            free_list_head = new_free_block; // New block becomes head.
+            set_list_head(arena, new_free_block); // New block becomes head.
         }
     } else {
+        INDEX_REMOVE(arena, block_to_split);
 
         // mark entire block as allocated.
         block_to_split->is_free = false;
@@ -135,11 +573,119 @@ static void split_and_prepare_block(BlockHeader *block_to_split,
         if (prev) {
             prev->next = block_to_split->next;
         } else {
-            free_list_head = block_to_split->next; // New block becomes head.
+            *arena->free_list_head =
+                block_to_split->next; // New block becomes head.
+        }
+
+        block_to_split->next = BLOCK_NONE; // Remove from free list chain
+    }
+}
+
+/**
+ * @brief Returns the offset just past the data of 'block'.
+ */
+static size_t block_end(const HeapArena *arena, const BlockHeader *block) {
+    return block_offset(arena, block) + sizeof(BlockHeader) + block->size;
+}
+
+/**
+ * @brief Finds the free block a long-lived or hot allocation is carved from.
+ *
+ * Hot blocks extend the hot run downwards when the free block right below
+ * it fits. Otherwise the highest fitting block is used, so hinted blocks
+ * collect at the top of the heap. Long-lived blocks avoid the block below
+ * the hot run unless nothing else fits.
+ *
+ * @param arena Arena to search.
+ * @param size Block data size needed.
+ * @param hot Whether the allocation is hot.
+ * @param prev_out Set to the block before the result in the free list.
+ * @return The chosen block, or NULL if no block is large enough.
+ */
+static BlockHeader *find_top_block(const HeapArena *arena, size_t size,
+                                   bool hot, BlockHeader **prev_out) {
+    BlockHeader *best = NULL;
+    BlockHeader *best_prev = NULL;
+    BlockHeader *below_hot = NULL;
+    BlockHeader *below_hot_prev = NULL;
+
+    BlockHeader *prev = NULL;
+    for (BlockHeader *current = list_head(arena); current != NULL;
+         prev = current, current = list_next(arena, current)) {
+        LATENCY_WALK(1);
+        if (!current->is_free || current->size < size) {
+            continue;
         }
 
-        block_to_split->next = NULL; // Remove from free list chain
+        if (block_end(arena, current) == arena->hot_floor) {
+            if (hot) {
+                *prev_out = prev;
+                return current;
+            }
+            below_hot = current;
+            below_hot_prev = prev;
+        } else if (best == NULL || current > best) {
+            best = current;
+            best_prev = prev;
+        }
+    }
+
+    if (best == NULL) {
+        best = below_hot;
+        best_prev = below_hot_prev;
+    }
+    *prev_out = best_prev;
+    return best;
+}
+
+/**
+ * @brief Carves an allocated block of 'size' from the top of a free block.
+ *
+ * The free block keeps its place in the free list and just shrinks. A
+ * non-zero 'gap' leaves that many bytes above the new block as a separate
+ * free block, which is linked right after 'block'. If too little would be
+ * left, the gap is dropped, and then the whole block is taken instead.
+ *
+ * @return The allocated block.
+ */
+static BlockHeader *carve_from_top(HeapArena *arena, BlockHeader *block,
+                                   size_t size, BlockHeader *prev,
+                                   size_t gap) {
+    const size_t min_block_total_size = sizeof(BlockHeader) + ALIGNMENT;
+
+    if (block->size < size + min_block_total_size + gap) {
+        gap = 0;
     }
+    if (block->size < size + min_block_total_size) {
+        split_and_prepare_block(arena, block, size, prev);
+        return block;
+    }
+
+    char *data_end = (char *) (block + 1) + block->size;
+    BlockHeader *carved =
+        (BlockHeader *) (data_end - gap - size - sizeof(BlockHeader));
+    JOURNAL_BLOCK(block);
+    JOURNAL_BLOCK(carved);
+
+    if (gap > 0) {
+        BlockHeader *rest = (BlockHeader *) (data_end - gap);
+        JOURNAL_BLOCK(rest);
+        rest->size = gap - sizeof(BlockHeader);
+        rest->is_free = true;
+        rest->flags = 0;
+        rest->next = block->next;
+        rest->magic = BLOCK_MAGIC;
+        set_list_next(arena, block, rest);
+        INDEX_INVALIDATE(arena); // 'rest' is not at the list head.
+    }
+
+    block->size -= gap + size + sizeof(BlockHeader);
+    INDEX_RESIZE(arena, block);
+    carved->size = size;
+    carved->is_free = false;
+    carved->next = BLOCK_NONE;
+    carved->magic = BLOCK_MAGIC;
+    return carved;
 }
 
 /**
@@ -147,38 +693,54 @@ static void split_and_prepare_block(BlockHeader *block_to_split,
  *
  * If the next block in memory is free, merge them into a single larger block.
  *
+ * @param arena Arena owning the block.
  * @param block_to_free Block to coalesce.
  * @return BlockHeader* Pointer to the coalesced block.
  */
-static BlockHeader *coalesce_block(BlockHeader *block_to_free) {
+static BlockHeader *coalesce_block(HeapArena *arena,
+                                   BlockHeader *block_to_free) {
     // Calculate the address of the expected next physical block's header.
     const BlockHeader *next_block =
         (BlockHeader *) ((char *) (block_to_free + 1) + block_to_free->size);
 
     // Check if the next block is within the heap bounds.
-    if (is_within_heap(next_block)) {
+    if (is_within_heap(arena, next_block)) {
         // Check if the next physical block is valid (magic) and marked as free
         if (next_block->magic == BLOCK_MAGIC && next_block->is_free) {
+            JOURNAL_BLOCK(block_to_free);
+            JOURNAL_HEAD(arena);
+
             // Remove the next_block from the free list.
-            BlockHeader *current = free_list_head;
+            BlockHeader *current = list_head(arena);
             BlockHeader *prev = NULL;
+#if HEAP_FREE_INDEX
+            // The index knows the predecessor; skip the walk.
+            size_t pos = free_index_entry(&arena->index, arena->base,
+                                          block_offset(arena, next_block));
+            if (pos != FREE_INDEX_NOT_FOUND) {
+                prev = block_at(arena, free_index_prev(&arena->index, pos));
+                current = (BlockHeader *) next_block;
+            }
+#endif
+            INDEX_REMOVE(arena, next_block);
 
             while (current != NULL) {
                 if (current == next_block) {
                     if (prev != NULL) {
+                        JOURNAL_BLOCK(prev);
                         prev->next = current->next;
                     } else {
-                        free_list_head = current->next;
+                        *arena->free_list_head = current->next;
                     }
                     break;
                 }
                 prev = current;
-                current = current->next;
+                current = list_next(arena, current);
             }
 
             // Edge case: ensure head is NULL if next_block was the only item.
-            if (free_list_head == next_block) {
-                free_list_head = NULL;
+            if (list_head(arena) == next_block) {
+                set_list_head(arena, NULL);
             }
 
             // Merge the blocks.
@@ -191,284 +753,1794 @@ static BlockHeader *coalesce_block(BlockHeader *block_to_free) {
     // Return the block.
     return block_to_free;
 }
+#endif
+
+/**
+ * @brief Clears the state kept alongside the heap (guard pool, profile,
+ * checkpoint journal) when a heap is (re)started.
+ */
+static void reset_side_state(void) {
+#if HEAP_DEBUG_GUARD
+    guard_reset();
+#endif
+#if HEAP_PROFILER
+    profiler_reset();
+#endif
+#if HEAP_LATENCY
+    latency_reset();
+#endif
+#if HEAP_BUDGETS
+    budget_reset();
+#endif
+#if HEAP_ISOLATION
+    isolation_reset();
+#endif
+#if HEAP_CHECKPOINT
+    journal_len = 0;
+    journal_active = false;
+    journal_open = 0;
+    journal_overflowed = false;
+    journal_generation++;
+#endif
+#if HEAP_HANDLES
+    HANDLES_LOCK();
+    memset(handle_table, 0, sizeof(handle_table));
+    memset(handle_locks, 0, sizeof(handle_locks));
+    HANDLES_UNLOCK();
+#endif
+}
+
+#if HEAP_MAPPED_BACKEND
+/**
+ * @brief Unmaps the current heap file, if any, and detaches arena 0.
+ */
+static void file_detach(void) {
+    if (heap_file != NULL) {
+        heap_file_close(heap_file);
+        heap_file = NULL;
+    }
+    arenas[0].free_list_head = &arenas[0].local_head;
+#if HEAP_THREAD_SAFE
+    arenas[0].lock = NULL; // Back to the local lock.
+#endif
+}
+
+/**
+ * @brief Maps 'name' as arena 0, formatting it unless an existing heap is
+ * being resumed (FILE) or joined (SHM).
+ *
+ * @return 0 on success, -1 on error (arena 0 is left empty).
+ */
+static int file_attach(const char *name, size_t size, bool reset) {
+    file_detach();
+    arena_count = 1;
+
+    bool fresh = false;
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+    HeapFileHeader *header = heap_shm_open(name, size, reset, &fresh);
+#else
+    HeapFileHeader *header = heap_file_open(name, size, reset, &fresh);
+#endif
+    if (header == NULL) {
+        arena_reset(&arenas[0], NULL, 0);
+        return -1;
+    }
+
+    heap_file = header;
+    arenas[0].free_list_head = &header->free_head;
+#if HEAP_THREAD_SAFE
+    arenas[0].lock = &header->lock;
+#endif
+    char *base = (char *) header + HEAP_FILE_HEADER_SIZE;
+    if (fresh) {
+        arena_reset(&arenas[0], base, header->heap_size);
+        heap_file_publish(header);
+    } else {
+        // Resume: the blocks and free list are already in the mapping.
+        arenas[0].base = base;
+        arenas[0].size = header->heap_size;
+        INDEX_INVALIDATE(&arenas[0]);
+    }
+    return 0;
+}
+#endif
+
+#if HEAP_REGIONS
+/**
+ * @brief Sets up one arena per region, highest priority first, with ties
+ * kept in array order.
+ *
+ * @return false if the regions are invalid (no arena is then live).
+ */
+static bool regions_reset(const HeapRegion *regions, size_t count) {
+    arena_count = 0;
+    if (regions == NULL || count == 0 || count > HEAP_MAX_REGIONS) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t start = (uintptr_t) regions[i].base;
+        if (start == 0 || regions[i].size < 2 * sizeof(BlockHeader) ||
+            regions[i].size > UINTPTR_MAX - start) {
+            return false;
+        }
+        for (size_t j = 0; j < i; j++) {
+            uintptr_t other = (uintptr_t) regions[j].base;
+            if (start < other + regions[j].size &&
+                other < start + regions[i].size) {
+                return false;
+            }
+        }
+    }
+
+    // Insertion sort of the region indices by descending priority.
+    size_t order[HEAP_MAX_REGIONS];
+    for (size_t i = 0; i < count; i++) {
+        size_t pos = i;
+        while (pos > 0 &&
+               regions[order[pos - 1]].priority < regions[i].priority) {
+            order[pos] = order[pos - 1];
+            pos--;
+        }
+        order[pos] = i;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const HeapRegion *region = &regions[order[i]];
+        // Keep block headers aligned even if the region is not.
+        size_t pad = (size_t) (-(uintptr_t) region->base & (ALIGNMENT - 1));
+        arena_reset(&arenas[i], (char *) region->base + pad,
+                    region->size - pad);
+        arenas[i].attrs = region->attrs;
+        arenas[i].priority = region->priority;
+        arenas[i].region = (int) order[i];
+
+        // Insertion sort of the arenas by address, for arena_of().
+        size_t pos = i;
+        while (pos > 0 && (uintptr_t) arenas_by_address[pos - 1]->base >
+                              (uintptr_t) arenas[i].base) {
+            arenas_by_address[pos] = arenas_by_address[pos - 1];
+            pos--;
+        }
+        arenas_by_address[pos] = &arenas[i];
+    }
+    arena_count = count;
+    return true;
+}
+#endif
 
 // --- Core Allocator Functions ---
 
 /**
  * @brief Initializes/resets the allocator.
  *
- * Sets up the entire heap as a single, large free block.
+ * Sets up the entire heap as a single, large free block. In NUMA mode,
+ * maps and binds one such heap per node instead. The FILE backend
+ * truncates HEAP_FILE_PATH and formats a fresh heap in it. The SHM backend
+ * attaches to the HEAP_SHM_NAME segment, and only formats it if it creates
+ * it; unlink the segment first to start over.
  */
 void allocator_init(void) {
+#if HEAP_MAINTENANCE
+    allocator_stop_maintenance();
+#endif
+    arena_count = 1;
+
 #if HEAP_BACKEND == HEAP_BACKEND_STATIC
-    heap_size = HEAP_SIZE;
+#if HEAP_REGIONS
+    const HeapRegion whole = {heap, HEAP_SIZE, 0, 0};
+    regions_reset(&whole, 1);
+#else
+    arena_reset(&arenas[0], heap, HEAP_SIZE);
+#endif
 #elif HEAP_BACKEND == HEAP_BACKEND_SBRK
     void *mem = sbrk(HEAP_SIZE);
     if (mem == (void *) -1) {
         perror("allocator_init: sbrk failed");
-        heap = NULL;
-        heap_size = 0;
+        arena_reset(&arenas[0], NULL, 0);
         return;
     }
-    heap = (char *) mem;
-    heap_size = HEAP_SIZE;
+    // Keep block headers aligned even if the break is not.
+    size_t pad = (size_t) (-(uintptr_t) mem & (ALIGNMENT - 1));
+    arena_reset(&arenas[0], (char *) mem + pad, HEAP_SIZE - pad);
 #elif HEAP_BACKEND == HEAP_BACKEND_MMAP
-    heap = (char *) mmap(NULL, HEAP_SIZE, PROT_READ | PROT_WRITE,
-                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (heap == MAP_FAILED) {
-        perror("allocator_init: mmap failed");
-        heap = NULL;
-        heap_size = 0;
-        return;
+#if HEAP_NUMA
+    arena_count = (size_t) numa_node_count();
+    if (arena_count > HEAP_MAX_ARENAS) {
+        arena_count = HEAP_MAX_ARENAS;
     }
-    heap_size = HEAP_SIZE;
+    numa_bind_failures = 0;
+    atomic_store(&numa_local_allocations, 0);
+    atomic_store(&numa_remote_allocations, 0);
+    atomic_store(&numa_cross_node_frees, 0);
 #endif
 
-#if HEAP_BACKEND == HEAP_BACKEND_SBRK || HEAP_BACKEND == HEAP_BACKEND_MMAP
-    if (heap == NULL || heap_size == 0) {
-        free_list_head = NULL;
-        return;
+    for (size_t i = 0; i < arena_count; i++) {
+        char *mem = (char *) mmap(NULL, HEAP_SIZE, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            perror("allocator_init: mmap failed");
+            arena_reset(&arenas[i], NULL, 0);
+            continue;
+        }
+#if HEAP_NUMA
+        // Bind before the first touch so pages are placed on the node.
+        if (!numa_bind(mem, HEAP_SIZE, (int) i)) {
+            numa_bind_failures++;
+        }
+#endif
+        arena_reset(&arenas[i], mem, HEAP_SIZE);
     }
+#elif HEAP_BACKEND == HEAP_BACKEND_FILE
+    file_attach(HEAP_FILE_PATH, HEAP_SIZE, true);
+#elif HEAP_BACKEND == HEAP_BACKEND_SHM
+    // Formatting a live segment would wipe other processes' buffers.
+    file_attach(HEAP_SHM_NAME, HEAP_SIZE, false);
 #endif
 
-    // Setup free list.
-    free_list_head = (BlockHeader *) heap;
-    free_list_head->size = HEAP_SIZE - sizeof(BlockHeader);
-    free_list_head->is_free = true;
-    free_list_head->next = NULL;
-    free_list_head->magic = BLOCK_MAGIC;
+    reset_side_state();
 }
 
+#if HEAP_DEBUG_GUARD
 /**
- * @brief Allocates 'size' bytes of uninitialized memory.
- *
- * Aligns the request, finds a suitable free block, splits if needed,
- * and returns a pointer to the allocated memory.
- *
- * @return void* Pointer to the allocated memory, or NULL if the request fails.
+ * @brief Writes the trailing canary right after the requested bytes.
  */
-void *my_malloc(size_t size) {
+static void arm_canary(BlockHeader *block, void *ptr, size_t requested) {
+    block->requested = requested;
+    memset((char *) ptr + requested, HEAP_CANARY_BYTE, MY_ALLOC_CANARY_SIZE);
+}
 
-    if (size == 0) {
-        return NULL;
+/**
+ * @brief Checks that the trailing canary of a block is untouched.
+ */
+static bool canary_intact(const BlockHeader *block, const void *ptr) {
+    const unsigned char *canary =
+        (const unsigned char *) ptr + block->requested;
+    for (size_t i = 0; i < MY_ALLOC_CANARY_SIZE; i++) {
+        if (canary[i] != HEAP_CANARY_BYTE) {
+            return false;
+        }
     }
+    return true;
+}
+#endif
 
-    size_t total_size = size + ALIGNMENT - 1 + sizeof(size_t);
-
+#if HEAP_POLICY == HEAP_POLICY_FIRST_FIT
+/**
+ * @brief Takes a block of 'class_size' from the free list, placed by
+ * 'hints'.
+ *
+ * @return The block, now allocated, or NULL if no free block is large
+ * enough.
+ */
+static BlockHeader *take_free_block(HeapArena *arena, size_t class_size,
+                                    unsigned hints) {
     // Find a suitable free block.
     BlockHeader *prev = NULL;
-    BlockHeader *block = find_free_block(total_size, &prev);
+    bool top = (hints & (HINT_LONG_LIVED | HINT_HOT)) != 0;
+    BlockHeader *block =
+        top ? find_top_block(arena, class_size, (hints & HINT_HOT) != 0, &prev)
+            : find_free_block(arena, class_size, &prev);
     if (block == NULL) {
         return NULL;
     }
 
-    // Align the data pointer.
-    void *raw_data_ptr = (void *) (block + 1);
-    uintptr_t raw_addr = (uintptr_t) raw_data_ptr;
-
-    // Calculate the aligned address after space for the offset storage.
-    uintptr_t aligned_addr_with_offset =
-        (raw_addr + sizeof(size_t) + ALIGNMENT - 1) &
-        ~(uintptr_t) (ALIGNMENT - 1);
-    void *aligned_data_ptr =
-        (void *) aligned_addr_with_offset; // Pointer to return to user.
-    void *offset_storage_ptr =
-        (void *) (aligned_addr_with_offset -
-                  sizeof(size_t)); // Pointer to store offset.
+    if (top) {
+        bool hot = (hints & HINT_HOT) != 0;
+        // Keep room for the hot run to grow instead of capping it.
+        size_t gap = (!hot && block_end(arena, block) == arena->hot_floor)
+                         ? HEAP_HINT_HOT_RESERVE
+                         : 0;
+        block = carve_from_top(arena, block, class_size, prev, gap);
+        if (hot) {
+            arena->hot_floor = block_offset(arena, block);
+        }
+    } else {
+        // Split the block if necessary.
+        split_and_prepare_block(arena, block, class_size, prev);
+    }
+    return block;
+}
+#endif
 
-    // Calculate the actual size of the used data.
-    size_t actual_used_data_size =
-        (size_t) ((char *) aligned_data_ptr + size - (char *) raw_data_ptr);
+#if HEAP_MAINTENANCE
+/**
+ * @brief Returns the whole pages inside a free block to the OS.
+ *
+ * Only mmap()ed arenas are released; they refault as zero pages.
+ */
+static void release_idle_block(HeapArena *arena, BlockHeader *block) {
+#if HEAP_BACKEND == HEAP_BACKEND_MMAP
+    uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t) (block + 1) + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t) (block + 1) + block->size) & ~(page - 1);
+    if (end > start &&
+        madvise((void *) start, end - start, MADV_DONTNEED) == 0) {
+        arena->cache.stats.released_bytes += end - start;
+    }
+#else
+    (void) arena;
+#endif
+    block->flags |= BLOCK_FLAG_RELEASED;
+}
+
+/**
+ * @brief Refills the caches asked for since the last pass, from the free
+ * list.
+ */
+static void refill_caches(HeapArena *arena) {
+    MaintenanceCache *cache = &arena->cache;
+    for (size_t bin = 0; bin < HEAP_MAINTENANCE_BINS; bin++) {
+        size_t size = (bin + 1) * ALIGNMENT;
+        unsigned target = cache->demand[bin] < HEAP_MAINTENANCE_BIN_DEPTH
+                              ? cache->demand[bin]
+                              : HEAP_MAINTENANCE_BIN_DEPTH;
+        cache->demand[bin] = 0;
+
+        while (cache->count[bin] < target) {
+            BlockHeader *prev = NULL;
+            BlockHeader *block = find_free_block(arena, size, &prev);
+            if (block == NULL) {
+                return;
+            }
+            split_and_prepare_block(arena, block, size, prev);
+            block->flags = 0;
+            // A block too small to split stays free for the next pass.
+            if (!cache_push(cache, block)) {
+                break;
+            }
+            cache->stats.cache_refills++;
+            cache->unmerged++;
+        }
+    }
+}
+
+/**
+ * @brief Runs a maintenance pass over 'arena', which must be locked.
+ *
+ * Walks the blocks in address order, merges each run of free blocks
+ * (cached and deferred ones included) into its first block, and rebuilds
+ * the free list from the runs, in address order. Blocks that were already
+ * on the list at the previous pass are released to the OS. Then the caches
+ * are refilled if 'refill' is set, and emptied otherwise.
+ */
+static void maintain_arena(HeapArena *arena, bool refill) {
+    MaintenanceCache *cache = &arena->cache;
+    BlockHeader *run = NULL;
+    BlockHeader *tail = NULL;
+
+    cache_clear(cache);
+    cache->unmerged = 0;
+    set_list_head(arena, NULL);
+    size_t pos = 0;
+    while (arena->base != NULL && pos < arena->size) {
+        BlockHeader *block = block_at(arena, pos);
+        pos += sizeof(BlockHeader) + block->size;
+        if (!block->is_free) {
+            run = NULL;
+        } else if (run != NULL) {
+            run->size += sizeof(BlockHeader) + block->size;
+            run->flags = 0; // A grown block starts idling again.
+            cache->stats.merges++;
+        } else {
+            run = block;
+            run->next = BLOCK_NONE;
+            if (tail != NULL) {
+                set_list_next(arena, tail, run);
+            } else {
+                set_list_head(arena, run);
+            }
+            tail = run;
+        }
+    }
+    INDEX_INVALIDATE(arena);
+
+    for (BlockHeader *block = list_head(arena); block != NULL;
+         block = list_next(arena, block)) {
+        if ((block->flags & (BLOCK_FLAG_IDLE | BLOCK_FLAG_RELEASED)) ==
+            BLOCK_FLAG_IDLE) {
+            release_idle_block(arena, block);
+        }
+        block->flags |= BLOCK_FLAG_IDLE;
+    }
+
+    if (refill) {
+        refill_caches(arena);
+    }
+    cache->stats.passes++;
+}
+#endif
+
+/**
+ * @brief Allocates a block from an arena's free list.
+ *
+ * Finds a suitable free block, splits if needed, stores the header offset
+ * in front of the user data and returns the aligned user pointer.
+ *
+ * @param arena Arena to allocate from.
+ * @param class_size Block data size, from MY_ALLOC_SIZE_CLASS().
+ * @param requested Bytes requested by the caller.
+ * @param hints MyAllocHint bits steering placement.
+ * @return void* Pointer to the allocated memory, or NULL if the request fails.
+ */
+static void *allocate_block(HeapArena *arena, size_t class_size,
+                            size_t requested, unsigned hints) {
+    ARENA_LOCK(arena);
+
+#if HEAP_POLICY != HEAP_POLICY_FIRST_FIT
+    // Segregated lists leave no room for placement hints.
+    (void) hints;
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+    BlockHeader *block =
+        tlsf_malloc(&arena->tlsf, arena->base, arena->size, class_size);
+#else
+    BlockHeader *block =
+        buddy_malloc(&arena->buddy, arena->base, arena->size, class_size);
+#endif
+    LATENCY_WALK(1);
+    if (block == NULL) {
+        ARENA_UNLOCK(arena);
+        return NULL;
+    }
+#else
+    BlockHeader *block = NULL;
+#if HEAP_MAINTENANCE
+    if ((hints & (HINT_LONG_LIVED | HINT_HOT)) == 0) {
+        block = cache_pop(&arena->cache, class_size);
+    }
+    if (block == NULL) {
+        block = take_free_block(arena, class_size, hints);
+    }
+    if (block == NULL && arena->cache.unmerged > 0) {
+        // Blocks freed since the last pass may add up to a fit. The thread
+        // merges them while this one waits; a heap that stays full asks
+        // only once per batch of frees.
+        ARENA_UNLOCK(arena);
+        bool merged = maintenance_thread_request_pass();
+        ARENA_LOCK(arena);
+        if (!merged && arena->cache.unmerged > 0) {
+            // The thread is just starting or stopping: merge here.
+            maintain_arena(arena, false);
+        }
+        block = take_free_block(arena, class_size, hints);
+    }
+#else
+    block = take_free_block(arena, class_size, hints);
+#endif
+    if (block == NULL) {
+        ARENA_UNLOCK(arena);
+        return NULL;
+    }
+#endif
+
+    // The block is ours from here on; finish it outside the lock.
+    ARENA_UNLOCK(arena);
+
+    // Headers are aligned, so the user data follows the prefix directly.
+    void *aligned_data_ptr = (char *) (block + 1) + MY_ALLOC_PREFIX_SIZE;
+    void *offset_storage_ptr = (char *) aligned_data_ptr - sizeof(size_t);
+
+    // Calculate and store the offset.
+    size_t offset = (size_t) ((char *) offset_storage_ptr - (char *) block);
+    *(size_t *) offset_storage_ptr = offset;
+
+#if HEAP_DEBUG_GUARD
+    arm_canary(block, aligned_data_ptr, requested);
+#endif
+#if HEAP_BUDGETS
+    block->tag = (uint8_t) budget_tag;
+    budget_charge(block->tag, (int64_t) block->size);
+#endif
+
+    block->flags = 0;
+#if HEAP_PROFILER
+    if (profiler_should_sample(requested)) {
+        block->flags |= BLOCK_FLAG_SAMPLED;
+        profiler_record(aligned_data_ptr, requested);
+    }
+#else
+    (void) requested;
+#endif
+
+    // Return the aligned data pointer.
+    return aligned_data_ptr;
+}
+
+/**
+ * @brief Allocates a block of 'class_size' from the best arena.
+ *
+ * Without NUMA there is a single arena. In NUMA mode, the calling thread's
+ * node is tried first and the other nodes are used only as a fallback. In
+ * region mode, see allocator_init_regions().
+ */
+static void *allocate_in_arenas(size_t class_size, size_t requested,
+                                unsigned hints) {
+#if HEAP_NUMA
+    size_t local = (size_t) numa_current_node() % arena_count;
+
+    void *ptr = allocate_block(&arenas[local], class_size, requested, hints);
+    if (ptr != NULL) {
+        atomic_fetch_add_explicit(&numa_local_allocations, 1,
+                                  memory_order_relaxed);
+        return ptr;
+    }
+
+    for (size_t i = 0; i < arena_count; i++) {
+        if (i == local) {
+            continue;
+        }
+        ptr = allocate_block(&arenas[i], class_size, requested, hints);
+        if (ptr != NULL) {
+            atomic_fetch_add_explicit(&numa_remote_allocations, 1,
+                                      memory_order_relaxed);
+            return ptr;
+        }
+    }
+    return NULL;
+#elif HEAP_REGIONS
+    unsigned required = hints >> HINT_REGION_SHIFT;
+    bool want_fast = (hints & HINT_HOT) != 0 ||
+                     class_size <= MY_ALLOC_SIZE_CLASS(HEAP_REGION_SMALL_MAX);
+
+    // Arenas are in priority order. The first sweep tries the regions of
+    // the preferred speed, the second the others.
+    for (int sweep = 0; sweep < 2; sweep++) {
+        for (size_t i = 0; i < arena_count; i++) {
+            unsigned attrs = arenas[i].attrs;
+            bool fast = (attrs & HEAP_REGION_FAST) != 0;
+            if ((attrs & required) != required ||
+                (fast == want_fast) != (sweep == 0)) {
+                continue;
+            }
+            void *ptr =
+                allocate_block(&arenas[i], class_size, requested, hints);
+            if (ptr != NULL) {
+                return ptr;
+            }
+        }
+    }
+    return NULL;
+#else
+    return allocate_block(&arenas[0], class_size, requested, hints);
+#endif
+}
+
+/**
+ * @brief Allocates a block of 'class_size' if the budgets allow it.
+ */
+static void *allocate(size_t class_size, size_t requested, unsigned hints) {
+#if HEAP_BUDGETS
+    if (!budget_admit(class_size)) {
+        return NULL;
+    }
+    void *ptr = allocate_in_arenas(class_size, requested, hints);
+    if (ptr == NULL) {
+        budget_no_memory(class_size);
+    }
+    return ptr;
+#else
+    return allocate_in_arenas(class_size, requested, hints);
+#endif
+}
+
+#if HEAP_ISOLATION
+static void *isolated_malloc(size_t size);
+static void free_impl(void *ptr);
+#endif
+
+/**
+ * @brief Body of my_malloc_hint(), without timing.
+ */
+static void *malloc_hint_impl(size_t size, unsigned hints) {
+
+    if (size == 0 || size > MY_ALLOC_MAX_REQUEST) {
+        return NULL;
+    }
+
+#if HEAP_ISOLATION
+    if ((hints & HINT_ISOLATED) != 0 || isolation_enabled) {
+        return isolated_malloc(size);
+    }
+#endif
+
+#if HEAP_DEBUG_GUARD
+    if (guard_should_sample()) {
+        void *guarded = guard_malloc(size);
+        if (guarded != NULL) {
+#if HEAP_PROFILER
+            if (profiler_should_sample(size)) {
+                profiler_record(guarded, size);
+            }
+#endif
+            return guarded;
+        }
+    }
+#endif
+
+    return allocate(MY_ALLOC_SIZE_CLASS(size), size, hints);
+}
+
+/**
+ * @brief Allocates 'size' bytes of uninitialized memory placed by 'hints'.
+ *
+ * Rounds the request up to its size class and allocates a block of that
+ * class. In debug mode, every HEAP_GUARD_SAMPLE_RATE-th request is placed
+ * against a guard page instead, whatever its hints.
+ *
+ * @return void* Pointer to the allocated memory, or NULL if the request fails.
+ */
+void *my_malloc_hint(size_t size, unsigned hints) {
+    LATENCY_BEGIN();
+    void *ptr = malloc_hint_impl(size, hints);
+    LATENCY_END(HEAP_OP_MALLOC);
+    return ptr;
+}
+
+/**
+ * @brief Allocates 'size' bytes of uninitialized memory.
+ *
+ * @return void* Pointer to the allocated memory, or NULL if the request fails.
+ */
+void *(my_malloc)(size_t size) {
+    return my_malloc_hint(size, HINT_NONE);
+}
+
+/**
+ * @brief Allocates a block of an already computed size class.
+ *
+ * @return void* Pointer to the allocated memory, or NULL if the request fails.
+ */
+void *my_malloc_class(size_t class_size) {
+    LATENCY_BEGIN();
+    void *ptr =
+        allocate(class_size,
+                 class_size - MY_ALLOC_PREFIX_SIZE - MY_ALLOC_CANARY_SIZE,
+                 HINT_NONE);
+    LATENCY_END(HEAP_OP_MALLOC);
+    return ptr;
+}
+
+/**
+ * @brief Body of my_malloc_aligned() for alignments above ALIGNMENT,
+ * without timing.
+ */
+static void *aligned_impl(size_t alignment, size_t size) {
+    if (size == 0 || size > MY_ALLOC_MAX_REQUEST - alignment) {
+        return NULL;
+    }
+
+    // Guard pages are skipped: their pointers sit at the end of a page.
+    size_t padded = size + alignment - ALIGNMENT;
+    char *ptr = allocate(MY_ALLOC_SIZE_CLASS(padded), padded, HINT_NONE);
+    if (ptr != NULL) {
+        char *aligned = (char *) (((uintptr_t) ptr + alignment - 1) &
+                                  ~(uintptr_t) (alignment - 1));
+        if (aligned != ptr) {
+            const char *block =
+                ptr - MY_ALLOC_PREFIX_SIZE - sizeof(BlockHeader);
+            char *offset_storage_ptr = aligned - sizeof(size_t);
+            *(size_t *) offset_storage_ptr =
+                (size_t) (offset_storage_ptr - block);
+            ptr = aligned;
+        }
+    }
+    return ptr;
+}
+
+/**
+ * @brief Allocates 'size' bytes at a multiple of 'alignment'.
+ *
+ * Over-aligned requests take a block padded by 'alignment' - ALIGNMENT
+ * bytes and move the user pointer up to the first aligned address; the
+ * offset word in front of it still leads back to the header.
+ *
+ * @return void* Pointer to the allocated memory, or NULL if the request fails.
+ */
+void *my_malloc_aligned(size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+    if (alignment <= ALIGNMENT) {
+        return my_malloc(size);
+    }
+
+    LATENCY_BEGIN();
+    void *ptr = aligned_impl(alignment, size);
+    LATENCY_END(HEAP_OP_MALLOC);
+    return ptr;
+}
+
+#if HEAP_ISOLATION
+/**
+ * @brief Allocates 'size' bytes on cache lines that no isolated object of
+ * another thread uses.
+ *
+ * Small requests are carved from the thread's run, which is replaced when
+ * full. Larger ones take whole lines of a block of their own.
+ */
+static void *isolated_malloc(size_t size) {
+    if (size > ISOLATION_MAX_CARVED) {
+        size_t lines = (size + HEAP_CACHE_LINE - 1) &
+                       ~(size_t) (HEAP_CACHE_LINE - 1);
+        return aligned_impl(HEAP_CACHE_LINE, lines);
+    }
+
+    void *ptr = isolation_carve(size);
+    if (ptr == NULL) {
+        void *run = aligned_impl(HEAP_CACHE_LINE, HEAP_ISOLATION_RUN_SIZE);
+        if (run == NULL) {
+            return NULL;
+        }
+        void *retired = isolation_adopt(run);
+        if (retired != NULL) {
+            free_impl(retired);
+        }
+        ptr = isolation_carve(size);
+    }
+    return ptr;
+}
+
+/**
+ * @brief Whether the tagged offset word in front of 'ptr' leads to a live
+ * run: a run header on a cache line at the start of a live block's data,
+ * with the object inside it.
+ */
+static bool carved_from_live_run(const void *ptr) {
+    const char *run = (const char *) isolation_run_of(ptr);
+    if (run == NULL || (uintptr_t) run % HEAP_CACHE_LINE != 0) {
+        return false;
+    }
+    const HeapArena *arena = arena_of(run);
+    const size_t *offset_word = (const size_t *) run - 1;
+    if (arena == NULL || !is_within_heap(arena, offset_word) ||
+        *offset_word % ALIGNMENT != 0) {
+        return false;
+    }
+    const BlockHeader *block =
+        (const BlockHeader *) ((const char *) offset_word - *offset_word);
+    return is_within_heap(arena, block) && block->magic == BLOCK_MAGIC &&
+           !block->is_free &&
+           (const char *) (block + 1) + block->size - run >=
+               HEAP_ISOLATION_RUN_SIZE &&
+           isolation_run_live(run);
+}
+
+/**
+ * @brief Whether 'ptr' is an object carved from a live isolation run.
+ */
+static bool is_carved(const void *ptr) {
+    return arena_of((const char *) ptr - sizeof(size_t)) != NULL &&
+           (uintptr_t) ptr % ALIGNMENT == 0 && isolation_owns(ptr) &&
+           carved_from_live_run(ptr);
+}
+#endif
+
+/**
+ * @brief Returns a validated, allocated block to its arena's free list.
+ *
+ * Must be called with the arena lock held.
+ *
+ * @param arena Arena owning the block.
+ * @param block_to_free Header of the block being released.
+ */
+static void release_block(HeapArena *arena, BlockHeader *block_to_free) {
+#if HEAP_DEBUG_GUARD
+    const void *ptr = (char *) (block_to_free + 1) + MY_ALLOC_PREFIX_SIZE;
+    if (!canary_intact(block_to_free, ptr)) {
+        fprintf(stderr,
+                "Error: Heap overflow detected past pointer %p (size %zu); "
+                "block @ %p is leaked.\n",
+                ptr, block_to_free->requested, (void *) block_to_free);
+        guard_note_canary_failure();
+        return;
+    }
+#endif
+
+#if HEAP_PROFILER
+    if (block_to_free->flags & BLOCK_FLAG_SAMPLED) {
+        profiler_forget((char *) (block_to_free + 1) + MY_ALLOC_PREFIX_SIZE);
+    }
+#endif
+
+#if HEAP_BUDGETS
+    budget_charge(block_to_free->tag, -(int64_t) block_to_free->size);
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+    tlsf_free(&arena->tlsf, arena->base, arena->size, block_to_free);
+#elif HEAP_POLICY == HEAP_POLICY_BUDDY
+    buddy_free(&arena->buddy, arena->base, arena->size, block_to_free);
+#else
+#if HEAP_MAINTENANCE
+    if (arena->cache.active) {
+        // Merging is left to the next maintenance pass.
+        arena->cache.unmerged++;
+        if (!cache_push(&arena->cache, block_to_free)) {
+            arena->cache.stats.deferred_frees++;
+        }
+        return;
+    }
+#endif
+    JOURNAL_BLOCK(block_to_free);
+    JOURNAL_HEAD(arena);
+
+    // mark the block as free
+    block_to_free->is_free = true;
+
+    // Coalesce with neighbors.
+    block_to_free = coalesce_block(arena, block_to_free);
+
+    // Add the block to the free list.
+    block_to_free->next = *arena->free_list_head;
+    set_list_head(arena, block_to_free);
+    INDEX_PUSH(arena, block_to_free);
+#endif
+}
+
+/**
+ * @brief Counts a free issued from a different node than the block's.
+ */
+static void note_free_origin(const HeapArena *arena) {
+#if HEAP_NUMA
+    size_t local = (size_t) numa_current_node() % arena_count;
+    if (arena != &arenas[local]) {
+        atomic_fetch_add_explicit(&numa_cross_node_frees, 1,
+                                  memory_order_relaxed);
+    }
+#else
+    (void) arena;
+#endif
+}
+
+/**
+ * @brief Body of my_free(), without timing.
+ */
+static void free_impl(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+#if HEAP_DEBUG_GUARD
+    if (guard_owns(ptr)) {
+#if HEAP_PROFILER
+        profiler_forget(ptr);
+#endif
+        guard_free(ptr);
+        return;
+    }
+#endif
+
+    // Basic boundary and alignment checks on user pointer.
+    HeapArena *arena = arena_of(ptr);
+    if (arena == NULL || ((uintptr_t) ptr % ALIGNMENT != 0)) {
+        fprintf(stderr, "Error: Attempting to free invalid pointer %p.\n", ptr);
+        return;
+    }
+
+    // Find offset storage location and check its bounds.
+    void *offset_storage_ptr = (void *) ((uintptr_t) ptr - sizeof(size_t));
+    if (!is_within_heap(arena, offset_storage_ptr)) {
+        fprintf(stderr,
+                "Error: Calculated offset storage pointer %p is out of heap "
+                "bounds (original ptr: %p).\n",
+                offset_storage_ptr, ptr);
+        return;
+    }
+
+    // Read offset and calculate header address.
+    size_t offset = *(size_t *) offset_storage_ptr;
+#if HEAP_ISOLATION
+    if ((offset & ISOLATION_TAG) != 0) {
+        if (!carved_from_live_run(ptr)) {
+            fprintf(stderr,
+                    "Error: Invalid isolation run (offset: %zx) for pointer "
+                    "%p.\n",
+                    offset, ptr);
+            return;
+        }
+        void *run = isolation_release(ptr);
+        if (run != NULL) {
+            free_impl(run);
+        }
+        return;
+    }
+#endif
+    BlockHeader *block_to_free =
+        (BlockHeader *) ((char *) offset_storage_ptr - offset);
+
+    ARENA_LOCK(arena);
+
+    // 5. Validate header (bounds and magic number)
+    if (!is_within_heap(arena, block_to_free) ||
+        block_to_free->magic != BLOCK_MAGIC) {
+        uint32_t current_magic =
+            is_within_heap(arena, block_to_free) ? block_to_free->magic : 0;
+        ARENA_UNLOCK(arena);
+        fprintf(stderr,
+                "Error: Invalid block header detected (addr: %p, magic: %x != "
+                "%x) for pointer %p.\n",
+                (void *) block_to_free, current_magic, BLOCK_MAGIC, ptr);
+        return;
+    }
+
+    // Check for double free
+    if (block_to_free->is_free) {
+        ARENA_UNLOCK(arena);
+        fprintf(stderr,
+                "Warning: Double free detected for pointer %p (block @ %p).\n",
+                ptr, (void *) block_to_free);
+        return;
+    }
+
+    release_block(arena, block_to_free);
+    ARENA_UNLOCK(arena);
+
+    note_free_origin(arena);
+}
+
+/**
+ * @brief Frees a block of memory previously allocated by my_malloc.
+ *
+ * Validates the pointer, marks the block free, coalesces with neighbor,
+ * and reinserts into the free list.
+ */
+void my_free(void *ptr) {
+    LATENCY_BEGIN();
+    free_impl(ptr);
+    LATENCY_END(HEAP_OP_FREE);
+}
+
+/**
+ * @brief Body of my_free_sized(), without timing.
+ */
+static void free_sized_impl(void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+
+#if HEAP_DEBUG_GUARD
+    if (guard_owns(ptr)) {
+#if HEAP_PROFILER
+        profiler_forget(ptr);
+#endif
+        guard_free(ptr);
+        return;
+    }
+#endif
+
+    BlockHeader *block =
+        (BlockHeader *) ((char *) ptr - MY_ALLOC_PREFIX_SIZE) - 1;
+    HeapArena *arena = arena_of(block);
+    const size_t *offset_word = (const size_t *) ptr - 1;
+
+    // Pointers moved up from the block start (my_malloc_aligned(), isolated
+    // objects) store a different offset; they are freed as by my_free().
+    if (arena != NULL && is_within_heap(arena, offset_word) &&
+        *offset_word !=
+            (size_t) ((const char *) offset_word - (const char *) block)) {
+        free_impl(ptr);
+        return;
+    }
+
+    if (arena != NULL) {
+        ARENA_LOCK(arena);
+        if (size != 0 && size <= MY_ALLOC_MAX_REQUEST &&
+            block->magic == BLOCK_MAGIC && !block->is_free &&
+            block->size >= MY_ALLOC_SIZE_CLASS(size)) {
+            release_block(arena, block);
+            ARENA_UNLOCK(arena);
+            note_free_origin(arena);
+            return;
+        }
+        ARENA_UNLOCK(arena);
+    }
+
+    fprintf(stderr,
+            "Error: my_free_sized(%p, %zu) does not match a live "
+            "allocation.\n",
+            ptr, size);
+}
+
+/**
+ * @brief Frees a block whose requested size is known to the caller.
+ *
+ * The header sits at a fixed distance from pointers handed out by
+ * my_malloc_class(), so no offset lookup is needed; 'size' only serves as
+ * a sanity check against the header. The offset word only tells those
+ * pointers apart from moved ones, which take the my_free() path.
+ */
+void my_free_sized(void *ptr, size_t size) {
+    LATENCY_BEGIN();
+    free_sized_impl(ptr, size);
+    LATENCY_END(HEAP_OP_FREE);
+}
+
+/**
+ * @brief Allocates memory for an array of nmembq elements of size bytes each
+ * and initializes all bits to zero.
+ *
+ * @return void* Pointer to allocated zeroed memory, or NULL on
+ * failure/overflow.
+ */
+void *my_calloc(size_t nmemb, size_t size) {
+
+    // Check for invalid input.
+    if (nmemb == 0 || size == 0) {
+        return NULL;
+    }
+
+    // Check for multiplication overflow before calculating total size.
+    size_t total_size;
+    if (nmemb > SIZE_MAX / size) {
+        return NULL;
+    }
+
+    total_size = nmemb * size;
+
+    // Allocate memory using my_malloc.
+    void *ptr = my_malloc(total_size);
+
+    // Initialize the allocated memory to zero.
+    if (ptr != NULL) {
+        memset(ptr, 0, total_size);
+    }
+
+    return ptr;
+}
+
+/**
+ * @brief Finds the header of a live block through the offset stored in
+ * front of 'ptr', reporting an invalid pointer as 'caller'.
+ *
+ * @return The block header, or NULL if 'ptr' is not a live heap block.
+ */
+static BlockHeader *live_header(const void *ptr, const char *caller) {
+    const void *offset_ptr = (const char *) ptr - sizeof(size_t);
+
+    // Basic bound check before dereferencing offset_ptr
+    const HeapArena *arena = arena_of(offset_ptr);
+    if (arena == NULL) {
+        fprintf(stderr,
+                "Error(%s): Offset pointer %p out of bounds for user ptr "
+                "%p.\n",
+                caller, offset_ptr, ptr);
+        return NULL;
+    }
+
+    size_t offset = *(const size_t *) offset_ptr;
+    BlockHeader *header = (BlockHeader *) ((const char *) offset_ptr - offset);
+
+    // Validate the retrieved header (crucial before reading size or freeing)
+    if (!is_within_heap(arena, header) || header->magic != BLOCK_MAGIC ||
+        header->is_free) {
+        fprintf(stderr, "Error(%s): Invalid header found for ptr %p.\n",
+                caller, ptr);
+        return NULL;
+    }
+    return header;
+}
+
+/**
+ * @brief Bytes from 'ptr' to the end of its block.
+ */
+static size_t data_capacity(const BlockHeader *block, const void *ptr) {
+    return (size_t) ((const char *) (block + 1) + block->size -
+                     (const char *) ptr);
+}
+
+#if HEAP_DEBUG_GUARD
+/**
+ * @brief Bytes between the block's first user byte and 'ptr', which
+ * my_malloc_aligned() moves up. The canary position counts from the former.
+ */
+static size_t data_lead(const BlockHeader *block, const void *ptr) {
+    return (size_t) ((const char *) ptr - (const char *) (block + 1)) -
+           MY_ALLOC_PREFIX_SIZE;
+}
+#endif
+
+/**
+ * @brief Body of my_realloc(), without timing.
+ */
+static void *realloc_impl(void *ptr, size_t new_size) {
+
+    // If ptr is NULL, behave like malloc(new_size)
+    if (ptr == NULL) {
+        return my_malloc(new_size);
+    }
+
+    // If new_size is 0, behave like free(ptr) and return NULL
+    if (new_size == 0) {
+        my_free(ptr);
+        return NULL;
+    }
+
+#if HEAP_DEBUG_GUARD
+    // Guarded blocks always move, so the old slot gets revoked.
+    if (guard_owns(ptr)) {
+        size_t old_size = guard_usable_size(ptr);
+        void *new_ptr = my_malloc(new_size);
+        if (new_ptr == NULL) {
+            return NULL;
+        }
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+        my_free(ptr);
+        return new_ptr;
+    }
+#endif
+
+#if HEAP_ISOLATION
+    // Carved objects cannot grow in place, and stay isolated when moved.
+    if (is_carved(ptr)) {
+        size_t old_size = isolation_size(ptr);
+        if (new_size <= old_size) {
+            return ptr;
+        }
+        void *new_ptr = my_malloc_hint(new_size, HINT_ISOLATED);
+        if (new_ptr == NULL) {
+            return NULL;
+        }
+        memcpy(new_ptr, ptr, old_size);
+        my_free(ptr);
+        return new_ptr;
+    }
+#endif
+
+    // Find the original block header using the offset
+    BlockHeader *old_block_header = live_header(ptr, "realloc");
+    if (old_block_header == NULL) {
+        return NULL;
+    }
+
+    // Usable data size: from the user pointer to the end of the block.
+    size_t old_data_size = data_capacity(old_block_header, ptr);
+
+#if HEAP_DEBUG_GUARD
+    // Resize in place if the canary still fits, otherwise copy only the
+    // requested bytes.
+    size_t lead = data_lead(old_block_header, ptr);
+    if (new_size <= old_data_size - MY_ALLOC_CANARY_SIZE) {
+        arm_canary(old_block_header, (char *) ptr - lead, lead + new_size);
+        return ptr;
+    }
+    old_data_size = old_block_header->requested - lead;
+#else
+    // Handle shrinking or same size: return original pointer
+    if (new_size <= old_data_size) {
+        return ptr;
+    }
+#endif
+
+    // Allocate new block
+    void *new_ptr = my_malloc(new_size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+
+    // Copy the data from the old block to the new block.
+    memcpy(new_ptr, ptr, old_data_size);
+
+    // Free the original block.
+    my_free(ptr);
+
+    // Return the pointer to the new block.
+    return new_ptr;
+}
+
+/**
+ * @brief Changes the size of the memory block pointed to by 'ptr' to 'size'
+ * bytes.
+ *
+ * @return void* Pointer to the resized memory block, or NULL if fails.
+ */
+void *my_realloc(void *ptr, size_t new_size) {
+    LATENCY_BEGIN();
+    void *new_ptr = realloc_impl(ptr, new_size);
+    LATENCY_END(HEAP_OP_REALLOC);
+    return new_ptr;
+}
 
-    // Split the block if necessary.
-    split_and_prepare_block(block, actual_used_data_size, prev);
+/**
+ * @brief Bytes the caller may use at 'ptr', at least the size requested.
+ *
+ * In debug mode this is the size requested (or last set by
+ * my_malloc_at_least()), since the canary follows it directly.
+ */
+size_t my_malloc_usable_size(const void *ptr) {
+    if (ptr == NULL) {
+        return 0;
+    }
 
-    // Calculate and store the offset.
-    size_t offset = (size_t) ((char *) offset_storage_ptr - (char *) block);
-    *(size_t *) offset_storage_ptr = offset;
+#if HEAP_DEBUG_GUARD
+    if (guard_owns(ptr)) {
+        return guard_usable_size(ptr);
+    }
+#endif
+#if HEAP_ISOLATION
+    if (is_carved(ptr)) {
+        return isolation_size(ptr);
+    }
+#endif
 
-    // Return the aligned data pointer.
-    return aligned_data_ptr;
+    const BlockHeader *block = live_header(ptr, "usable_size");
+    if (block == NULL) {
+        return 0;
+    }
+#if HEAP_DEBUG_GUARD
+    return block->requested - data_lead(block, ptr);
+#else
+    return data_capacity(block, ptr);
+#endif
 }
 
 /**
- * @brief Frees a block of memory previously allocated by my_malloc.
+ * @brief Allocates at least 'size' bytes and reports the whole capacity.
  *
- * Validates the pointer, marks the block free, coalesces with neighbor,
- * and reinserts into the free list.
+ * The slack left by size-class rounding and unsplit blocks is handed to the
+ * caller. In debug mode the canary is moved behind it.
  */
-void my_free(void *ptr) {
-    if (ptr == NULL) {
-        return;
+void *my_malloc_at_least(size_t size, size_t *actual) {
+#if HEAP_ISOLATION
+    // Isolated objects hand out no slack.
+    if (isolation_enabled) {
+        void *ptr = my_malloc(size);
+        if (actual != NULL) {
+            *actual = ptr != NULL ? size : 0;
+        }
+        return ptr;
     }
+#endif
 
-    // Basic boundary and alignment checks on user pointer.
-    if (!is_within_heap(ptr) || ((uintptr_t) ptr % ALIGNMENT != 0)) {
-        fprintf(stderr, "Error: Attempting to free invalid pointer %p.\n", ptr);
-        return;
+    LATENCY_BEGIN();
+    void *ptr = malloc_hint_impl(size, HINT_NONE);
+    size_t capacity = 0;
+    if (ptr != NULL) {
+#if HEAP_DEBUG_GUARD
+        if (guard_owns(ptr)) {
+            capacity = size;
+        } else {
+            BlockHeader *block =
+                (BlockHeader *) ((char *) ptr - MY_ALLOC_PREFIX_SIZE) - 1;
+            capacity = data_capacity(block, ptr) - MY_ALLOC_CANARY_SIZE;
+            arm_canary(block, ptr, capacity);
+        }
+#else
+        const BlockHeader *block =
+            (const BlockHeader *) ((char *) ptr - MY_ALLOC_PREFIX_SIZE) - 1;
+        capacity = data_capacity(block, ptr);
+#endif
     }
+    LATENCY_END(HEAP_OP_MALLOC);
 
-    // Find offset storage location and check its bounds.
-    void *offset_storage_ptr = (void *) ((uintptr_t) ptr - sizeof(size_t));
-    if (!is_within_heap(offset_storage_ptr)) {
-        fprintf(stderr,
-                "Error: Calculated offset storage pointer %p is out of heap "
-                "bounds (original ptr: %p).\n",
-                offset_storage_ptr, ptr);
-        return;
+    if (actual != NULL) {
+        *actual = capacity;
     }
+    return ptr;
+}
 
-    // Read offset and calculate header address.
-    size_t offset = *(size_t *) offset_storage_ptr;
-    BlockHeader *block_to_free =
-        (BlockHeader *) ((char *) offset_storage_ptr - offset);
+void allocator_destroy(void) {
+#if HEAP_MAINTENANCE
+    allocator_stop_maintenance();
+#endif
+#if HEAP_ISOLATION
+    isolation_reset();
+#endif
+    for (size_t i = 0; i < arena_count; i++) {
+#if HEAP_BACKEND == HEAP_BACKEND_MMAP
+        if (arenas[i].base != NULL && arenas[i].size > 0) {
+            munmap(arenas[i].base, arenas[i].size);
+        }
+#elif HEAP_BACKEND == HEAP_BACKEND_SBRK
+        // sbrk() memory is contiguous with the program's data segment.
+        // Releasing it with sbrk(-HEAP_SIZE) is possible but fragile,
+        // as it must be the last sbrk call made by the program.
+        // We'll let the OS reclaim it when the process exits.
+#elif HEAP_MAPPED_BACKEND
+        file_detach();
+#endif
+        arenas[i].base = NULL;
+        arenas[i].size = 0;
+        *arenas[i].free_list_head = BLOCK_NONE;
+        INDEX_INVALIDATE(&arenas[i]);
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+        tlsf_reset(&arenas[i].tlsf, NULL, 0);
+#elif HEAP_POLICY == HEAP_POLICY_BUDDY
+        buddy_reset(&arenas[i].buddy, NULL, 0);
+#endif
+    }
+    arena_count = 0;
 
-    // 5. Validate header (bounds and magic number)
-    if (!is_within_heap(block_to_free) || block_to_free->magic != BLOCK_MAGIC) {
-        uint32_t current_magic =
-            is_within_heap(block_to_free) ? block_to_free->magic : 0;
-        fprintf(stderr,
-                "Error: Invalid block header detected (addr: %p, magic: %x != "
-                "%x) for pointer %p.\n",
-                (void *) block_to_free, current_magic, BLOCK_MAGIC, ptr);
+#if HEAP_DEBUG_GUARD
+    guard_destroy();
+#endif
+}
+
+#if HEAP_REGIONS
+int allocator_init_regions(const HeapRegion *regions, size_t count) {
+#if HEAP_MAINTENANCE
+    allocator_stop_maintenance();
+#endif
+    bool ok = regions_reset(regions, count);
+    reset_side_state();
+    return ok ? 0 : -1;
+}
+
+int allocator_region_of(const void *ptr) {
+    const HeapArena *arena = arena_of(ptr);
+    return arena != NULL ? arena->region : -1;
+}
+#endif
+
+#if HEAP_MAINTENANCE
+void maintenance_set_active(bool active) {
+    for (size_t i = 0; i < arena_count; i++) {
+        ARENA_LOCK(&arenas[i]);
+        arenas[i].cache.active = active;
+        if (!active) {
+            maintain_arena(&arenas[i], false);
+        }
+        ARENA_UNLOCK(&arenas[i]);
+    }
+}
+
+int allocator_start_maintenance(unsigned interval_ms) {
+    return maintenance_thread_start(interval_ms) ? 0 : -1;
+}
+
+void allocator_stop_maintenance(void) {
+    maintenance_thread_stop();
+}
+
+void allocator_run_maintenance(void) {
+    for (size_t i = 0; i < arena_count; i++) {
+        ARENA_LOCK(&arenas[i]);
+        maintain_arena(&arenas[i], arenas[i].cache.active);
+        ARENA_UNLOCK(&arenas[i]);
+    }
+}
+
+void allocator_get_maintenance_stats(HeapMaintenanceStats *out) {
+    if (out == NULL) {
         return;
     }
+    memset(out, 0, sizeof(*out));
+    for (size_t i = 0; i < arena_count; i++) {
+        ARENA_LOCK(&arenas[i]);
+        const HeapMaintenanceStats *stats = &arenas[i].cache.stats;
+        out->passes += stats->passes;
+        out->merges += stats->merges;
+        out->deferred_frees += stats->deferred_frees;
+        out->cache_hits += stats->cache_hits;
+        out->cache_misses += stats->cache_misses;
+        out->cache_refills += stats->cache_refills;
+        out->released_bytes += stats->released_bytes;
+        ARENA_UNLOCK(&arenas[i]);
+    }
+}
+#endif
 
-    // Check for double free
-    if (block_to_free->is_free) {
-        fprintf(stderr,
-                "Warning: Double free detected for pointer %p (block @ %p).\n",
-                ptr, (void *) block_to_free);
+#if HEAP_NUMA
+void allocator_get_numa_stats(HeapNumaStats *out) {
+    if (out == NULL) {
         return;
     }
+    out->nodes = arena_count;
+    out->local_allocations = atomic_load(&numa_local_allocations);
+    out->remote_allocations = atomic_load(&numa_remote_allocations);
+    out->cross_node_frees = atomic_load(&numa_cross_node_frees);
+    out->bind_failures = numa_bind_failures;
+}
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_FILE
+int allocator_open_file(const char *path, size_t size) {
+    if (path == NULL || size < sizeof(BlockHeader) + ALIGNMENT) {
+        return -1;
+    }
+    int result = file_attach(path, MY_ALLOC_ALIGN_UP(size), false);
+    reset_side_state();
+    return result;
+}
+#endif
 
-    // mark the block as free
-    block_to_free->is_free = true;
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+int allocator_open_shared(const char *name, size_t size) {
+    if (name == NULL || size < sizeof(BlockHeader) + ALIGNMENT) {
+        return -1;
+    }
+    int result = file_attach(name, MY_ALLOC_ALIGN_UP(size), false);
+    reset_side_state();
+    return result;
+}
 
-    // Coalesce with neighbors.
-    block_to_free = coalesce_block(block_to_free);
+int allocator_unlink_shared(const char *name) {
+    return (name != NULL && shm_unlink(name) == 0) ? 0 : -1;
+}
+#endif
 
-    // Add the block to the free list.
-    block_to_free->next = free_list_head;
-    free_list_head = block_to_free;
+#if HEAP_MAPPED_BACKEND
+int allocator_sync(void) {
+    return heap_file != NULL ? heap_file_sync(heap_file) : -1;
+}
+
+size_t allocator_ptr_to_offset(const void *ptr) {
+    if (!is_within_heap(&arenas[0], ptr)) {
+        return BLOCK_NONE;
+    }
+    return (size_t) ((const char *) ptr - arenas[0].base);
 }
 
+void *allocator_offset_to_ptr(size_t offset) {
+    if (arenas[0].base == NULL || offset >= arenas[0].size) {
+        return NULL;
+    }
+    return arenas[0].base + offset;
+}
+
+void allocator_set_root(void *ptr) {
+    if (heap_file == NULL) {
+        return;
+    }
+    ARENA_LOCK(&arenas[0]);
+    heap_file->root = allocator_ptr_to_offset(ptr);
+    ARENA_UNLOCK(&arenas[0]);
+}
+
+void *allocator_get_root(void) {
+    if (heap_file == NULL) {
+        return NULL;
+    }
+    ARENA_LOCK(&arenas[0]);
+    void *root = allocator_offset_to_ptr(heap_file->root);
+    ARENA_UNLOCK(&arenas[0]);
+    return root;
+}
+#endif
+
+#if HEAP_CHECKPOINT
 /**
- * @brief Allocates memory for an array of nmembq elements of size bytes each
- * and initializes all bits to zero.
+ * @brief Records the current free-structure state.
  *
- * @return void* Pointer to allocated zeroed memory, or NULL on
- * failure/overflow.
+ * Taking a checkpoint only starts (or continues) journaling; the cost is
+ * paid by later metadata writes, one journal entry each.
  */
-void *my_calloc(size_t nmemb, size_t size) {
+HeapCheckpoint allocator_checkpoint(void) {
+    ARENA_LOCK(&arenas[0]);
+    HeapCheckpoint cp = {journal_len, journal_generation};
+    journal_open++;
+    if (!journal_overflowed) {
+        journal_active = true;
+    }
+    ARENA_UNLOCK(&arenas[0]);
+    return cp;
+}
 
-    // Check for invalid input.
-    if (nmemb == 0 || size == 0) {
-        return NULL;
+/**
+ * @brief Finishes one checkpoint; finishing the last open one empties the
+ * journal and ends journaling.
+ *
+ * Nested checkpoints may share a position, so only the count of open ones
+ * tells the outermost apart.
+ */
+static void journal_close(void) {
+    if (journal_open > 0 && --journal_open == 0) {
+        journal_len = 0;
+        journal_active = false;
+        journal_overflowed = false;
     }
+}
 
-    // Check for multiplication overflow before calculating total size.
-    size_t total_size;
-    if (nmemb > SIZE_MAX / size) {
-        return NULL;
+/**
+ * @brief Restores the free-structure state recorded by 'cp'.
+ *
+ * Undoes journal entries newest first, so the time taken is proportional
+ * to the metadata writes made since the checkpoint.
+ */
+bool allocator_rollback(HeapCheckpoint cp) {
+    ARENA_LOCK(&arenas[0]);
+
+    if (cp.generation != journal_generation || journal_overflowed ||
+        journal_open == 0 || cp.position > journal_len) {
+        ARENA_UNLOCK(&arenas[0]);
+        return false;
     }
 
-    total_size = nmemb * size;
+    while (journal_len > cp.position) {
+        journal_len--;
+        memcpy(journal[journal_len].addr, journal[journal_len].old,
+               journal[journal_len].len);
+    }
+    INDEX_INVALIDATE(&arenas[0]);
 
-    // Allocate memory using my_malloc.
-    void *ptr = my_malloc(total_size);
+    journal_close();
+    ARENA_UNLOCK(&arenas[0]);
+    return true;
+}
 
-    // Initialize the allocated memory to zero.
-    if (ptr != NULL) {
-        memset(ptr, 0, total_size);
+/**
+ * @brief Keeps everything done since 'cp'.
+ *
+ * Inner commits keep their entries for an outer rollback.
+ */
+void allocator_commit(HeapCheckpoint cp) {
+    ARENA_LOCK(&arenas[0]);
+    if (cp.generation == journal_generation) {
+        journal_close();
     }
+    ARENA_UNLOCK(&arenas[0]);
+}
+#endif
 
-    return ptr;
+#if HEAP_HANDLES
+/**
+ * @brief Returns the table slot of a handle, or HEAP_HANDLE_SLOTS if 'h'
+ * is not a live handle.
+ */
+static size_t handle_index(HHandle h) {
+    if (h < handle_table || h >= handle_table + HEAP_HANDLE_SLOTS ||
+        *h == NULL) {
+        return HEAP_HANDLE_SLOTS;
+    }
+    return (size_t) (h - handle_table);
 }
 
 /**
- * @brief Changes the size of the memory block pointed to by 'ptr' to 'size'
- * bytes.
+ * @brief Finds the master pointer of a block that compaction may move.
  *
- * @return void* Pointer to the resized memory block, or NULL if fails.
+ * @return The master pointer, or NULL if the block must stay in place.
+ * Must be called with the handle table locked.
  */
-void *my_realloc(void *ptr, size_t new_size) {
+static void **movable_slot(const BlockHeader *block) {
+    if ((block->flags & BLOCK_FLAG_HANDLE) == 0 ||
+        (block->flags & BLOCK_FLAG_SAMPLED) != 0) {
+        return NULL; // Raw pointers, and profiler entries, would go stale.
+    }
 
-    // If ptr is NULL, behave like malloc(new_size)
-    if (ptr == NULL) {
-        return my_malloc(new_size);
+    const void *ptr = (const char *) (block + 1) + MY_ALLOC_PREFIX_SIZE;
+    for (size_t i = 0; i < HEAP_HANDLE_SLOTS; i++) {
+        if (handle_table[i] == ptr) {
+            return handle_locks[i] == 0 ? &handle_table[i] : NULL;
+        }
     }
+    return NULL; // Being freed.
+}
 
-    // If new_size is 0, behave like free(ptr) and return NULL
-    if (new_size == 0) {
-        my_free(ptr);
-        return NULL;
+/**
+ * @brief Turns [from, to) into a free block appended to the free list.
+ *
+ * @return Data size of the new block, or 0 if the range is empty.
+ */
+static size_t add_free_range(HeapArena *arena, size_t from, size_t to,
+                             BlockHeader **tail) {
+    if (to - from < sizeof(BlockHeader) + ALIGNMENT) {
+        return 0; // Free blocks are never smaller, so this range is empty.
     }
 
-    // Find the original block header using the offset
-    void *offset_ptr = (void *) ((uintptr_t) ptr - sizeof(size_t));
+    BlockHeader *block = block_at(arena, from);
+    block->size = to - from - sizeof(BlockHeader);
+    block->is_free = true;
+    block->flags = 0;
+    block->next = BLOCK_NONE;
+    block->magic = BLOCK_MAGIC;
 
-    // Basic bound check before dereferencing offset_ptr
-    if (!is_within_heap(offset_ptr)) {
-        fprintf(stderr,
-                "Error(realloc): Offset pointer %p out of bounds for user ptr "
-                "%p.\n",
-                offset_ptr, ptr);
-        return NULL;
+    if (*tail != NULL) {
+        set_list_next(arena, *tail, block);
+    } else {
+        set_list_head(arena, block);
+    }
+    *tail = block;
+    return block->size;
+}
+
+/**
+ * @brief Compacts one arena in a single pass over its blocks.
+ *
+ * Movable blocks slide down to 'dest'; a pinned block ends the current
+ * run of free space, which becomes one free block. The free list is
+ * rebuilt in address order.
+ *
+ * @return Size of the largest free block of the arena.
+ */
+static size_t compact_arena(HeapArena *arena) {
+    size_t largest = 0;
+    size_t dest = 0;
+    size_t pos = 0;
+    BlockHeader *tail = NULL;
+
+    ARENA_LOCK(arena);
+#if HEAP_MAINTENANCE
+    // Cached blocks are free space to the pass below.
+    cache_clear(&arena->cache);
+#endif
+#if HEAP_CHECKPOINT
+    // Moved blocks cannot be journaled; refuse rollbacks past this point.
+    if (journal_active) {
+        journal_overflowed = true;
     }
+#endif
 
-    size_t offset = *(size_t *) offset_ptr;
-    const BlockHeader *old_block_header =
-        (BlockHeader *) ((char *) offset_ptr - offset);
+    set_list_head(arena, NULL);
+    while (arena->base != NULL && pos < arena->size) {
+        BlockHeader *block = block_at(arena, pos);
+        size_t total = sizeof(BlockHeader) + block->size;
+
+        if (!block->is_free) {
+            void **slot = movable_slot(block);
+            if (slot != NULL) {
+                if (dest != pos) {
+                    memmove(arena->base + dest, block, total);
+                    *slot = (char *) *slot - (pos - dest);
+                }
+                dest += total;
+            } else {
+                size_t size = add_free_range(arena, dest, pos, &tail);
+                largest = size > largest ? size : largest;
+                dest = pos + total;
+            }
+        }
+        pos += total;
+    }
 
-    // Validate the retrieved header (crucial before reading size or freeing)
-    if (!is_within_heap(old_block_header) ||
-        old_block_header->magic != BLOCK_MAGIC || old_block_header->is_free) {
-        fprintf(stderr, "Error(realloc): Invalid header found for ptr %p.\n",
-                ptr);
-        return NULL;
+    if (arena->base != NULL) {
+        size_t size = add_free_range(arena, dest, arena->size, &tail);
+        largest = size > largest ? size : largest;
     }
+    arena->hot_floor = BLOCK_NONE;
+    INDEX_INVALIDATE(arena);
+    ARENA_UNLOCK(arena);
+    return largest;
+}
 
-    size_t old_data_size = old_block_header->size; // Usable data size.
+size_t allocator_compact(void) {
+    size_t largest = 0;
+    HANDLES_LOCK();
+    for (size_t i = 0; i < arena_count; i++) {
+        size_t size = compact_arena(&arenas[i]);
+        largest = size > largest ? size : largest;
+    }
+    HANDLES_UNLOCK();
+    return largest;
+}
 
-    // Handle shrinking or same size: return original pointer
-    if (new_size <= old_data_size) {
-        return ptr;
+/**
+ * @brief Registers 'ptr' in a free handle slot.
+ *
+ * @return The handle, or NULL if the table is full.
+ */
+static HHandle handle_register(void *ptr) {
+    HANDLES_LOCK();
+    for (size_t i = 0; i < HEAP_HANDLE_SLOTS; i++) {
+        if (handle_table[i] == NULL) {
+            handle_table[i] = ptr;
+            handle_locks[i] = 0;
+            HeapArena *arena = arena_of(ptr);
+            if (arena != NULL) {
+                const size_t *offset_ptr =
+                    (const size_t *) ((char *) ptr - sizeof(size_t));
+                BlockHeader *block =
+                    (BlockHeader *) ((char *) offset_ptr - *offset_ptr);
+                block->flags |= BLOCK_FLAG_HANDLE;
+            }
+            HANDLES_UNLOCK();
+            return &handle_table[i];
+        }
     }
+    HANDLES_UNLOCK();
+    return NULL;
+}
 
-    // Allocate new block
-    void *new_ptr = my_malloc(new_size);
-    if (new_ptr == NULL) {
+HHandle hhandle_alloc(size_t size) {
+    void *ptr = my_malloc(size);
+    if (ptr == NULL && size != 0 && size <= MY_ALLOC_MAX_REQUEST) {
+        allocator_compact();
+        ptr = my_malloc(size);
+    }
+    if (ptr == NULL) {
         return NULL;
     }
 
-    // Copy the data from the old block to the new block.
-    memcpy(new_ptr, ptr, old_data_size);
+    HHandle h = handle_register(ptr);
+    if (h == NULL) {
+        my_free(ptr);
+    }
+    return h;
+}
 
-    // Free the original block.
+void hhandle_free(HHandle h) {
+    HANDLES_LOCK();
+    size_t index = handle_index(h);
+    if (index == HEAP_HANDLE_SLOTS) {
+        HANDLES_UNLOCK();
+        fprintf(stderr, "Error: Invalid or double free of handle %p.\n",
+                (void *) h);
+        return;
+    }
+    void *ptr = handle_table[index];
+    handle_table[index] = NULL;
+    handle_locks[index] = 0;
+    HANDLES_UNLOCK();
+
+    // No longer in the table, so compaction leaves the block alone.
     my_free(ptr);
+}
 
-    // Return the pointer to the new block.
-    return new_ptr;
+void *hlock(HHandle h) {
+    HANDLES_LOCK();
+    size_t index = handle_index(h);
+    void *ptr = NULL;
+    if (index != HEAP_HANDLE_SLOTS) {
+        handle_locks[index]++;
+        ptr = handle_table[index];
+    }
+    HANDLES_UNLOCK();
+    return ptr;
 }
 
-void allocator_destroy(void) {
-#if HEAP_BACKEND == HEAP_BACKEND_MMAP
-    if (heap != NULL && heap_size > 0) {
-        munmap(heap, heap_size);
+void hunlock(HHandle h) {
+    HANDLES_LOCK();
+    size_t index = handle_index(h);
+    if (index != HEAP_HANDLE_SLOTS && handle_locks[index] > 0) {
+        handle_locks[index]--;
     }
-#elif HEAP_BACKEND == HEAP_BACKEND_SBRK
-    // sbrk() memory is contiguous with the program's data segment.
-    // Releasing it with sbrk(-HEAP_SIZE) is possible but fragile,
-    // as it must be the last sbrk call made by the program.
-    // We'll let the OS reclaim it when the process exits.
+    HANDLES_UNLOCK();
+}
+#endif
 
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+void allocator_get_tlsf_stats(HeapTlsfStats *out) {
+    if (out == NULL) {
+        return;
+    }
+    *out = (HeapTlsfStats) {0};
+    for (size_t i = 0; i < arena_count; i++) {
+        ARENA_LOCK(&arenas[i]);
+        const TlsfControl *tlsf = &arenas[i].tlsf;
+        if (tlsf->max_malloc_steps > out->max_malloc_steps) {
+            out->max_malloc_steps = tlsf->max_malloc_steps;
+        }
+        if (tlsf->max_free_steps > out->max_free_steps) {
+            out->max_free_steps = tlsf->max_free_steps;
+        }
+        ARENA_UNLOCK(&arenas[i]);
+    }
+}
 #endif
 
-#if HEAP_BACKEND == HEAP_BACKEND_SBRK || HEAP_BACKEND == HEAP_BACKEND_MMAP
-    heap = NULL;
+#if HEAP_POLICY == HEAP_POLICY_BUDDY
+void allocator_get_buddy_stats(HeapBuddyStats *out) {
+    if (out == NULL) {
+        return;
+    }
+    *out = (HeapBuddyStats) {0};
+    for (size_t i = 0; i < arena_count; i++) {
+        ARENA_LOCK(&arenas[i]);
+        const BuddyControl *buddy = &arenas[i].buddy;
+        out->splits += buddy->splits;
+        out->merges += buddy->merges;
+        if (buddy->bitmap != 0) {
+            unsigned top = 63 - (unsigned) __builtin_clzll(buddy->bitmap);
+            size_t largest = ((size_t) 1 << top) - sizeof(BlockHeader);
+            if (largest > out->largest_free) {
+                out->largest_free = largest;
+            }
+        }
+        ARENA_UNLOCK(&arenas[i]);
+    }
+}
 #endif
 
-    heap_size = 0;
-    free_list_head = NULL;
-}
\ No newline at end of file
+#if HEAP_FREE_INDEX
+void allocator_set_free_index(bool enabled) {
+    for (size_t i = 0; i < HEAP_MAX_ARENAS; i++) {
+        // Arenas not set up yet have no lock but keep the setting.
+        bool live = i < arena_count;
+        if (live) {
+            ARENA_LOCK(&arenas[i]);
+        }
+        arenas[i].index.disabled = !enabled;
+        arenas[i].index.valid = false; // Rebuilt on next use if enabled.
+        if (live) {
+            ARENA_UNLOCK(&arenas[i]);
+        }
+    }
+}
+#endif
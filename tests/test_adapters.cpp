@@ -0,0 +1,92 @@
+/**
+ * @file test_adapters.cpp
+ * @brief Unit tests for the C++ adapters in heap_engine.hpp.
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "heap_engine.hpp"
+#include "unity.h"
+
+#include <cstdint>
+#include <vector>
+
+void setUp(void) {
+    allocator_init();
+}
+
+void tearDown(void) {}
+
+/** Elements per vector: well over any size the heap serves specially. */
+constexpr std::size_t ELEMENTS = 128;
+
+/** Rounds of growing and dropping a vector; a leak exhausts the heap. */
+constexpr std::size_t ROUNDS = 8 * HEAP_SIZE / (ELEMENTS * sizeof(uint64_t));
+
+// Reserving up front gives each round a single buffer to return.
+template <class Vector> void grow_and_drop(const Vector &empty) {
+    for (std::size_t round = 0; round < ROUNDS; round++) {
+        Vector vector(empty.get_allocator());
+        vector.reserve(ELEMENTS);
+        for (std::size_t i = 0; i < ELEMENTS; i++) {
+            vector.push_back(round + i);
+        }
+        TEST_ASSERT_EQUAL_UINT64(round + ELEMENTS - 1, vector.back());
+    }
+}
+
+/**
+ * @brief Verifies heap_engine::allocator<T> returns every buffer it gets.
+ */
+void test_allocator_returns_every_buffer(void) {
+    grow_and_drop(std::vector<uint64_t, heap_engine::allocator<uint64_t>>());
+}
+
+/**
+ * @brief Verifies the memory resource returns every buffer it gets.
+ */
+void test_memory_resource_returns_every_buffer(void) {
+    grow_and_drop(
+        std::pmr::vector<uint64_t>(heap_engine::get_memory_resource()));
+}
+
+/**
+ * @brief Verifies over-aligned types are aligned and freed.
+ */
+void test_allocator_over_aligned_type(void) {
+    struct alignas(64) Line {
+        uint64_t value;
+    };
+    heap_engine::allocator<Line> allocator;
+    for (std::size_t round = 0; round < ROUNDS; round++) {
+        Line *lines = allocator.allocate(4);
+        TEST_ASSERT_EQUAL_UINT(0, (uintptr_t) lines % alignof(Line));
+        allocator.deallocate(lines, 4);
+    }
+}
+
+#if HEAP_ISOLATION
+/**
+ * @brief Verifies buffers of an isolating thread, which sized frees must
+ * find through their offset word, are returned by both adapters.
+ */
+void test_adapters_with_thread_isolation(void) {
+    allocator_set_thread_isolation(true);
+    grow_and_drop(std::vector<uint64_t, heap_engine::allocator<uint64_t>>());
+    grow_and_drop(
+        std::pmr::vector<uint64_t>(heap_engine::get_memory_resource()));
+    allocator_set_thread_isolation(false);
+}
+#endif
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_allocator_returns_every_buffer);
+    RUN_TEST(test_memory_resource_returns_every_buffer);
+    RUN_TEST(test_allocator_over_aligned_type);
+#if HEAP_ISOLATION
+    RUN_TEST(test_adapters_with_thread_isolation);
+#endif
+    return UNITY_END();
+}
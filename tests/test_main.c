@@ -16,15 +16,62 @@
 #include <stdint.h>
 #include <string.h>
 
+#if HEAP_DEBUG_GUARD
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_FILE
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if (HEAP_BUDGETS && HEAP_THREAD_SAFE) || HEAP_MAINTENANCE || HEAP_ISOLATION
+#include <pthread.h>
+#endif
+
 #define ALIGNMENT 8
 
+// In NUMA mode every node gets its own HEAP_SIZE heap.
+#if HEAP_NUMA
+#define TEST_HEAP_COUNT HEAP_NUMA_MAX_NODES
+#else
+#define TEST_HEAP_COUNT 1
+#endif
+
 // --- Test Setup ---
 
 void setUp(void) {
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+    // allocator_init() attaches to a live segment; start each test afresh.
+    allocator_unlink_shared(HEAP_SHM_NAME);
+#endif
     allocator_init();
 }
 
-void tearDown(void) {}
+void tearDown(void) {
+#if HEAP_DEBUG_GUARD
+    // Undoes bypass_guard_sampling() and any rate a test set.
+    allocator_set_guard_sample_rate(HEAP_GUARD_SAMPLE_RATE);
+#endif
+}
+
+/**
+ * @brief Serves every allocation from the heap for the rest of the test, so
+ * it can reason about block placement. tearDown() restores sampling.
+ */
+static void bypass_guard_sampling(void) {
+#if HEAP_DEBUG_GUARD
+    allocator_set_guard_sample_rate(0);
+#endif
+}
 
 // --- Malloc Tests ---
 
@@ -94,6 +141,58 @@ void test_malloc_fails_when_heap_too_small(void) {
     TEST_ASSERT_NULL(ptr);
 }
 
+/**
+ * @brief Verifies constant-size requests take the size-class fast path and
+ * land in the same block a runtime-sized request would.
+ */
+void test_malloc_constant_size_uses_size_class(void) {
+    typedef struct {
+        int data;
+        void *next;
+    } Node;
+
+    Node *node = (Node *) my_malloc(sizeof(Node));
+    TEST_ASSERT_NOT_NULL(node);
+    TEST_ASSERT_EQUAL_UINT(0, (uintptr_t) node % ALIGNMENT);
+    my_free(node);
+
+    volatile size_t runtime_size = sizeof(Node);
+    void *ptr = my_malloc(runtime_size);
+    TEST_ASSERT_EQUAL_PTR(node, ptr);
+    my_free(ptr);
+
+    TEST_ASSERT_NULL(my_malloc(SIZE_MAX));
+}
+
+/** my_malloc_class() calls made through the my_malloc() macro. */
+static unsigned class_calls = 0;
+
+// Counts the calls the dispatch below makes, until the #undef after it.
+#define my_malloc_class(class_size)                                            \
+    (class_calls++, (my_malloc_class)(class_size))
+
+/**
+ * @brief Verifies only constant sizes are dispatched to my_malloc_class(),
+ * and only where the header enables the dispatch.
+ */
+void test_malloc_dispatches_only_constant_sizes(void) {
+    void *constant = my_malloc(24);
+    volatile size_t runtime_size = 24;
+    void *runtime = my_malloc(runtime_size);
+    TEST_ASSERT_NOT_NULL(constant);
+    TEST_ASSERT_NOT_NULL(runtime);
+
+#ifdef my_malloc
+    TEST_ASSERT_EQUAL_UINT(1, class_calls);
+#else
+    TEST_ASSERT_EQUAL_UINT(0, class_calls);
+#endif
+    my_free(constant);
+    my_free(runtime);
+}
+
+#undef my_malloc_class
+
 // --- Free Tests ---
 
 /**
@@ -173,6 +272,59 @@ void test_double_free(void) {
     TEST_ASSERT_TRUE(true);
 }
 
+/**
+ * @brief Verifies sized free releases the block like my_free does.
+ */
+void test_free_sized_should_reuse_memory(void) {
+    void *ptr1 = my_malloc(24);
+    TEST_ASSERT_NOT_NULL(ptr1);
+
+    my_free_sized(ptr1, 24);
+
+    void *ptr2 = my_malloc(24);
+    TEST_ASSERT_EQUAL_PTR(ptr1, ptr2);
+
+    my_free_sized(ptr2, 24);
+}
+
+/**
+ * @brief Verifies sized free rejects a size larger than the block.
+ */
+void test_free_sized_rejects_wrong_size(void) {
+    void *ptr1 = my_malloc(16);
+    TEST_ASSERT_NOT_NULL(ptr1);
+
+    my_free_sized(ptr1, 4096);
+
+    // The block must still be allocated.
+    void *ptr2 = my_malloc(16);
+    TEST_ASSERT_NOT_NULL(ptr2);
+    TEST_ASSERT_NOT_EQUAL(ptr1, ptr2);
+
+    my_free(ptr1);
+    my_free(ptr2);
+}
+
+/**
+ * @brief Verifies sized free checks 'size' against the header at the fixed
+ * distance below the pointer, which it finds without the offset word.
+ */
+void test_free_sized_checks_header_at_fixed_distance(void) {
+    bypass_guard_sampling();
+    char *ptr = (char *) my_malloc(24);
+    TEST_ASSERT_NOT_NULL(ptr);
+    BlockHeader *header = (BlockHeader *) (ptr - MY_ALLOC_PREFIX_SIZE) - 1;
+    TEST_ASSERT_EQUAL_HEX32(BLOCK_MAGIC, header->magic);
+
+    // One byte more than the header holds is refused; my_free() has no
+    // size to check.
+    my_free_sized(ptr, header->size + 1);
+    TEST_ASSERT_FALSE(header->is_free);
+
+    my_free_sized(ptr, 24);
+    TEST_ASSERT_EQUAL_PTR(ptr, my_malloc(24));
+}
+
 // --- Calloc Tests ---
 
 /**
@@ -294,6 +446,167 @@ void test_realloc_grow_block_new_location(void) {
     my_free(ptr2);
 }
 
+// --- Usable Size and Alignment Tests ---
+
+/**
+ * @brief Verifies the whole usable size can be written without touching
+ * the next block.
+ */
+void test_usable_size_covers_request(void) {
+    bypass_guard_sampling();
+    char *ptr = (char *) my_malloc(13);
+    TEST_ASSERT_NOT_NULL(ptr);
+    char *next = (char *) my_malloc(24);
+    TEST_ASSERT_NOT_NULL(next);
+    memset(next, 'N', 24);
+
+    size_t usable = my_malloc_usable_size(ptr);
+    TEST_ASSERT_GREATER_OR_EQUAL(13, usable);
+    memset(ptr, 'U', usable);
+    TEST_ASSERT_EQUAL_PTR(ptr, my_realloc(ptr, usable));
+
+    for (int i = 0; i < 24; i++) {
+        TEST_ASSERT_EQUAL_CHAR('N', next[i]);
+    }
+    my_free(ptr);
+    my_free(next);
+
+#if HEAP_DEBUG_GUARD
+    HeapGuardStats stats;
+    allocator_get_guard_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(0, stats.canary_failures);
+#endif
+}
+
+/**
+ * @brief Verifies my_malloc_at_least() reports a capacity that can be
+ * grown into in place and passed to my_free_sized().
+ */
+void test_malloc_at_least_reports_capacity(void) {
+    size_t actual = 0;
+    char *ptr = (char *) my_malloc_at_least(13, &actual);
+    TEST_ASSERT_NOT_NULL(ptr);
+    TEST_ASSERT_GREATER_OR_EQUAL(13, actual);
+    TEST_ASSERT_EQUAL_size_t(actual, my_malloc_usable_size(ptr));
+
+    memset(ptr, 'C', actual);
+    TEST_ASSERT_EQUAL_PTR(ptr, my_realloc(ptr, actual));
+    my_free_sized(ptr, actual);
+
+#if HEAP_DEBUG_GUARD
+    HeapGuardStats stats;
+    allocator_get_guard_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(0, stats.canary_failures);
+#endif
+}
+
+/**
+ * @brief Verifies NULL and failed requests report no capacity.
+ */
+void test_usable_size_of_null_and_failures(void) {
+    TEST_ASSERT_EQUAL_size_t(0, my_malloc_usable_size(NULL));
+
+    size_t actual = 1;
+    TEST_ASSERT_NULL(my_malloc_at_least(0, &actual));
+    TEST_ASSERT_EQUAL_size_t(0, actual);
+
+    actual = 1;
+    TEST_ASSERT_NULL(my_malloc_at_least(SIZE_MAX / 2, &actual));
+    TEST_ASSERT_EQUAL_size_t(0, actual);
+}
+
+/**
+ * @brief Verifies over-aligned blocks are aligned, resize in place and are
+ * freed through the moved pointer.
+ */
+void test_malloc_aligned_returns_aligned_blocks(void) {
+    const size_t alignments[] = {16, 64, 256};
+    for (size_t i = 0; i < sizeof(alignments) / sizeof(alignments[0]); i++) {
+        char *ptr = (char *) my_malloc_aligned(alignments[i], 40);
+        TEST_ASSERT_NOT_NULL(ptr);
+        TEST_ASSERT_EQUAL_UINT(0, (uintptr_t) ptr % alignments[i]);
+        TEST_ASSERT_GREATER_OR_EQUAL(40, my_malloc_usable_size(ptr));
+        memset(ptr, 'L', 40);
+
+        TEST_ASSERT_EQUAL_PTR(ptr, my_realloc(ptr, 20));
+#if HEAP_DEBUG_GUARD
+        // The canary moved to the new end, past the alignment padding.
+        TEST_ASSERT_EQUAL_size_t(20, my_malloc_usable_size(ptr));
+#else
+        TEST_ASSERT_GREATER_OR_EQUAL(20, my_malloc_usable_size(ptr));
+#endif
+        my_free(ptr);
+    }
+
+    // Sized frees find the header of moved pointers through the offset.
+    for (size_t i = 0; i < 4 * HEAP_SIZE / 300; i++) {
+        void *ptr = my_malloc_aligned(64, 300);
+        TEST_ASSERT_NOT_NULL(ptr);
+        my_free_sized(ptr, 300);
+    }
+
+    TEST_ASSERT_NULL(my_malloc_aligned(24, 40));
+    TEST_ASSERT_NULL(my_malloc_aligned(0, 40));
+
+#if HEAP_DEBUG_GUARD
+    HeapGuardStats stats;
+    allocator_get_guard_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(0, stats.canary_failures);
+#endif
+}
+
+#if HEAP_POLICY == HEAP_POLICY_FIRST_FIT
+// --- Allocation Hint Tests ---
+
+/**
+ * @brief Verifies long-lived blocks stack down from the top of the heap,
+ * away from short-lived blocks taken from the bottom.
+ */
+void test_malloc_hint_separates_long_and_short_lived(void) {
+    const size_t stride = sizeof(BlockHeader) + MY_ALLOC_SIZE_CLASS(64);
+
+    char *short1 = (char *) my_malloc(64);
+    char *long1 = (char *) my_malloc_hint(64, HINT_LONG_LIVED);
+    char *long2 = (char *) my_malloc_hint(64, HINT_LONG_LIVED);
+    char *short2 = (char *) my_malloc_hint(64, HINT_SHORT_LIVED);
+    TEST_ASSERT_NOT_NULL(short1);
+    TEST_ASSERT_NOT_NULL(long1);
+    TEST_ASSERT_NOT_NULL(long2);
+    TEST_ASSERT_NOT_NULL(short2);
+
+    TEST_ASSERT_EQUAL_PTR(short1 + stride, short2);
+    TEST_ASSERT_EQUAL_PTR(long1 - stride, long2);
+    TEST_ASSERT_TRUE(long2 - short2 > HEAP_SIZE / 2);
+
+    my_free(short2);
+    my_free(long2);
+    my_free(long1);
+    my_free(short1);
+}
+
+/**
+ * @brief Verifies hot blocks stay contiguous even when a long-lived block
+ * is allocated between them.
+ */
+void test_malloc_hint_hot_blocks_stay_contiguous(void) {
+    const size_t stride = sizeof(BlockHeader) + MY_ALLOC_SIZE_CLASS(32);
+
+    char *hot1 = (char *) my_malloc_hint(32, HINT_HOT);
+    char *cold = (char *) my_malloc_hint(32, HINT_LONG_LIVED);
+    char *hot2 = (char *) my_malloc_hint(32, HINT_HOT | HINT_LONG_LIVED);
+    TEST_ASSERT_NOT_NULL(hot1);
+    TEST_ASSERT_NOT_NULL(cold);
+    TEST_ASSERT_NOT_NULL(hot2);
+
+    TEST_ASSERT_EQUAL_PTR(hot1 - stride, hot2);
+    TEST_ASSERT_TRUE(hot2 - cold >= HEAP_HINT_HOT_RESERVE);
+
+    my_free(hot2);
+    my_free(cold);
+    my_free(hot1);
+}
+#endif
+
 // --- Scenario Tests ---
 
 /**
@@ -329,7 +642,8 @@ void test_fragmentation_scenario(void) {
  * @brief Tests allocating repeatedly until the heap is exhausted.
  */
 void test_exhaust_heap(void) {
-    void *blocks[HEAP_SIZE / (sizeof(BlockHeader) + ALIGNMENT + 10)];
+    void *blocks[TEST_HEAP_COUNT * HEAP_SIZE /
+                 (sizeof(BlockHeader) + ALIGNMENT + 10)];
     int count = 0;
     size_t alloc_size = 10;
 
@@ -349,40 +663,1818 @@ void test_exhaust_heap(void) {
     }
 }
 
+#if HEAP_DEBUG_GUARD
+// --- Hardened Debug Mode Tests ---
+
 /**
- * @brief Main function to run all unit tests.
- *
+ * @brief Runs 'fn' in a child process and reports whether it faulted.
  */
-int main(void) {
-    UNITY_BEGIN(); // Sets up Unity
+static bool faults_in_child(void (*fn)(void)) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        fn();
+        _exit(0);
+    }
 
-    // --- Malloc Tests ---
-    RUN_TEST(test_malloc_basic_should_return_non_null);
-    RUN_TEST(test_malloc_should_split_large_block);
-    RUN_TEST(test_malloc_should_return_aligned_memory);
-    RUN_TEST(test_malloc_zero_size);
-    RUN_TEST(test_malloc_fails_when_heap_too_small);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV;
+}
 
-    // --- Free Tests ---
-    RUN_TEST(test_free_should_reuse_memory);
-    RUN_TEST(test_free_should_coalesce_adjacent_blocks);
-    RUN_TEST(test_free_null_pointer);
-    RUN_TEST(test_invalid_free);
-    RUN_TEST(test_double_free);
+static void overflow_guarded_block(void) {
+    allocator_set_guard_sample_rate(1);
+    volatile char *ptr = (char *) my_malloc(32);
+    ptr[32] = 'X';
+}
 
-    // --- Calloc Tests ---
-    RUN_TEST(test_calloc_should_return_zeroed_memory);
-    RUN_TEST(test_calloc_should_fail_on_overflow);
+static void use_guarded_block_after_free(void) {
+    allocator_set_guard_sample_rate(1);
+    volatile char *ptr = (char *) my_malloc(32);
+    my_free((void *) ptr);
+    ptr[0] = 'X';
+}
 
-    // --- Realloc Tests ---
-    RUN_TEST(test_realloc_null_ptr_acts_like_malloc);
-    RUN_TEST(test_realloc_zero_size_acts_like_free);
-    RUN_TEST(test_realloc_should_shrink_block);
-    RUN_TEST(test_realloc_grow_block_new_location);
+/**
+ * @brief Verifies a one-byte overflow of a heap block trips its canary.
+ */
+void test_debug_canary_detects_overflow(void) {
+    bypass_guard_sampling();
+    char *ptr = (char *) my_malloc(10);
+    TEST_ASSERT_NOT_NULL(ptr);
 
-    // --- Scenario Tests ---
-    RUN_TEST(test_fragmentation_scenario);
-    RUN_TEST(test_exhaust_heap);
+    ptr[10] = 'X';
+    my_free(ptr);
+
+    HeapGuardStats stats;
+    allocator_get_guard_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(1, stats.canary_failures);
+    TEST_ASSERT_EQUAL_UINT(0, stats.sampled_allocations);
+}
+
+/**
+ * @brief Verifies a sampled allocation faults on overflow and after free.
+ */
+void test_debug_guard_page_traps_overflow_and_use_after_free(void) {
+    TEST_ASSERT_TRUE(faults_in_child(overflow_guarded_block));
+    TEST_ASSERT_TRUE(faults_in_child(use_guarded_block_after_free));
+}
+
+/**
+ * @brief Verifies sampling follows the configured rate and guarded blocks
+ * behave like regular ones through realloc and free.
+ */
+void test_debug_guard_sampling_and_realloc(void) {
+    allocator_set_guard_sample_rate(2);
+
+    char *regular = (char *) my_malloc(24);
+    char *guarded = (char *) my_malloc(24);
+    TEST_ASSERT_NOT_NULL(regular);
+    TEST_ASSERT_NOT_NULL(guarded);
+
+    HeapGuardStats stats;
+    allocator_get_guard_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(1, stats.sampled_allocations);
+    TEST_ASSERT_EQUAL_UINT(1, stats.guarded_live);
+
+    memset(guarded, 'G', 24);
+    char *moved = (char *) my_realloc(guarded, 100);
+    TEST_ASSERT_NOT_NULL(moved);
+    for (int i = 0; i < 24; i++) {
+        TEST_ASSERT_EQUAL_CHAR('G', moved[i]);
+    }
+
+    my_free(moved);
+    my_free(regular);
+
+    allocator_get_guard_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(0, stats.guarded_live);
+    TEST_ASSERT_EQUAL_UINT(0, stats.canary_failures);
+}
+#endif
+
+#if HEAP_PROFILER
+// --- Heap Profiler Tests ---
+
+/**
+ * @brief Allocation site that shows up as its own stack in the profile.
+ */
+static void *profiled_allocation_site(size_t size) {
+    return my_malloc(size);
+}
+
+/**
+ * @brief Verifies sampled allocations are tracked until freed and dumped
+ * in the pprof heap format.
+ */
+void test_profiler_tracks_live_sampled_allocations(void) {
+    allocator_set_profile_sample_period(1);
+
+    void *a = profiled_allocation_site(96);
+    void *b = profiled_allocation_site(200);
+    void *c = my_malloc(304);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_NOT_NULL(c);
+
+    my_free(b);
+
+    HeapProfileStats stats;
+    allocator_get_profile_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(2, stats.live_samples);
+    TEST_ASSERT_EQUAL_UINT(400, stats.live_bytes);
+
+    FILE *out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_EQUAL_INT(0, allocator_dump_profile(out));
+    rewind(out);
+
+    char line[256];
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), out));
+    TEST_ASSERT_EQUAL_STRING("heap profile: 2: 400 [2: 400] @ heap_v2/1\n",
+                             line);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), out));
+    TEST_ASSERT_NOT_NULL(strstr(line, "@ 0x"));
+    fclose(out);
+
+    my_free(a);
+    my_free(c);
+
+    allocator_get_profile_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(0, stats.live_samples);
+    TEST_ASSERT_EQUAL_UINT(0, stats.live_bytes);
+
+    allocator_set_profile_sample_period(HEAP_PROFILER_SAMPLE_PERIOD);
+}
+
+/**
+ * @brief Verifies the default period leaves small allocations unsampled.
+ */
+void test_profiler_default_period_skips_small_allocations(void) {
+    void *ptr = my_malloc(64);
+    TEST_ASSERT_NOT_NULL(ptr);
+
+    HeapProfileStats stats;
+    allocator_get_profile_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(0, stats.live_samples);
+
+    my_free(ptr);
+}
+#endif
+
+#if HEAP_NUMA
+// --- NUMA Tests ---
+
+/**
+ * @brief Verifies allocations are served from the caller's node heap.
+ */
+void test_numa_allocations_prefer_local_node(void) {
+    HeapNumaStats stats;
+    allocator_get_numa_stats(&stats);
+    TEST_ASSERT_TRUE(stats.nodes >= 1);
+
+    void *ptr = my_malloc(64);
+    TEST_ASSERT_NOT_NULL(ptr);
+    my_free(ptr);
+
+    allocator_get_numa_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(1, stats.local_allocations);
+    TEST_ASSERT_EQUAL_UINT(0, stats.remote_allocations);
+    TEST_ASSERT_EQUAL_UINT(0, stats.cross_node_frees);
+}
+
+/**
+ * @brief Verifies a full local heap spills over to another node.
+ */
+void test_numa_falls_back_to_remote_node(void) {
+    HeapNumaStats stats;
+    allocator_get_numa_stats(&stats);
+    if (stats.nodes < 2) {
+        TEST_IGNORE_MESSAGE("Single-node machine; set HEAP_NUMA_NODES=2.");
+    }
+
+    void *first = my_malloc(HEAP_SIZE / 2);
+    void *second = my_malloc(HEAP_SIZE / 2);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_NOT_NULL(second);
+
+    allocator_get_numa_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(1, stats.local_allocations);
+    TEST_ASSERT_EQUAL_UINT(1, stats.remote_allocations);
+
+    my_free(second);
+    my_free(first);
+
+    allocator_get_numa_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT(1, stats.cross_node_frees);
+}
+#endif
+
+#if HEAP_CHECKPOINT
+// --- Checkpoint Tests ---
+
+/**
+ * @brief Verifies rolling back frees everything allocated since the
+ * checkpoint without calling my_free.
+ */
+void test_checkpoint_rollback_releases_new_allocations(void) {
+    HeapCheckpoint cp = allocator_checkpoint();
+
+    void *first = my_malloc(40);
+    TEST_ASSERT_NOT_NULL(first);
+    for (int i = 0; i < 40; i++) {
+        TEST_ASSERT_NOT_NULL(my_malloc(16));
+    }
+
+    TEST_ASSERT_TRUE(allocator_rollback(cp));
+
+    // The whole heap is one free block again.
+    void *all = my_malloc(HEAP_SIZE - sizeof(BlockHeader) - 64);
+    TEST_ASSERT_EQUAL_PTR(first, all);
+    my_free(all);
+}
+
+/**
+ * @brief Verifies blocks live at the checkpoint survive the rollback, even
+ * if they were freed after it.
+ */
+void test_checkpoint_rollback_restores_freed_blocks(void) {
+    char *kept = (char *) my_malloc(64);
+    TEST_ASSERT_NOT_NULL(kept);
+    memset(kept, 'K', 64);
+
+    HeapCheckpoint cp = allocator_checkpoint();
+    my_free(kept);
+    void *reused = my_malloc(64);
+    TEST_ASSERT_EQUAL_PTR(kept, reused);
+    TEST_ASSERT_TRUE(allocator_rollback(cp));
+
+    // 'kept' is allocated again: a new block must not overlap it.
+    void *other = my_malloc(64);
+    TEST_ASSERT_NOT_NULL(other);
+    TEST_ASSERT_NOT_EQUAL(kept, other);
+
+    my_free(other);
+    my_free(kept);
+}
+
+/**
+ * @brief Verifies nested checkpoints roll back independently.
+ */
+void test_checkpoint_nested_rollback(void) {
+    HeapCheckpoint outer = allocator_checkpoint();
+    void *a = my_malloc(32);
+
+    HeapCheckpoint inner = allocator_checkpoint();
+    void *b = my_malloc(32);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_TRUE(allocator_rollback(inner));
+
+    // 'a' is still allocated, 'b' is free again.
+    void *c = my_malloc(32);
+    TEST_ASSERT_EQUAL_PTR(b, c);
+    TEST_ASSERT_NOT_EQUAL(a, c);
+
+    TEST_ASSERT_TRUE(allocator_rollback(outer));
+    TEST_ASSERT_EQUAL_PTR(a, my_malloc(32));
+}
+
+/**
+ * @brief Verifies finishing an inner checkpoint taken at the same position
+ * as the outer one keeps the outer one journaling.
+ */
+void test_checkpoint_nested_at_same_position(void) {
+    HeapCheckpoint outer = allocator_checkpoint();
+    HeapCheckpoint inner = allocator_checkpoint();
+    TEST_ASSERT_TRUE(allocator_rollback(inner));
+    void *first = my_malloc(64);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_TRUE(allocator_rollback(outer));
+    TEST_ASSERT_EQUAL_PTR(first, my_malloc(64));
+
+    allocator_init();
+    outer = allocator_checkpoint();
+    inner = allocator_checkpoint();
+    allocator_commit(inner);
+    first = my_malloc(64);
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_TRUE(allocator_rollback(outer));
+    TEST_ASSERT_EQUAL_PTR(first, my_malloc(64));
+}
+
+/** Malloc and free pairs filling most of the journal. */
+#define CHECKPOINT_ALLOCATIONS (HEAP_JOURNAL_CAPACITY / 8)
+
+/**
+ * @brief Verifies a checkpoint survives as many allocations and frees as
+ * the default journal holds.
+ */
+void test_checkpoint_rollback_after_many_allocations(void) {
+    void *live[32] = {NULL};
+    HeapCheckpoint cp = allocator_checkpoint();
+
+    for (size_t i = 0; i < CHECKPOINT_ALLOCATIONS; i++) {
+        size_t slot = i % 32;
+        my_free(live[slot]);
+        live[slot] = my_malloc(32);
+        TEST_ASSERT_NOT_NULL(live[slot]);
+    }
+
+    TEST_ASSERT_TRUE(allocator_rollback(cp));
+
+    // The whole heap is one free block again.
+    void *all = my_malloc(HEAP_SIZE - sizeof(BlockHeader) - 64);
+    TEST_ASSERT_NOT_NULL(all);
+    my_free(all);
+}
+
+/**
+ * @brief Verifies stale and overflowed checkpoints are refused.
+ */
+void test_checkpoint_rejects_stale_and_overflowed(void) {
+    HeapCheckpoint cp = allocator_checkpoint();
+    allocator_init();
+    TEST_ASSERT_FALSE(allocator_rollback(cp));
+
+    cp = allocator_checkpoint();
+    for (int i = 0; i < HEAP_JOURNAL_CAPACITY; i++) {
+        void *ptr = my_malloc(8);
+        my_free(ptr);
+    }
+    TEST_ASSERT_FALSE(allocator_rollback(cp));
+
+    // Committing the outermost checkpoint re-arms journaling.
+    allocator_commit(cp);
+    cp = allocator_checkpoint();
+    TEST_ASSERT_NOT_NULL(my_malloc(8));
+    TEST_ASSERT_TRUE(allocator_rollback(cp));
+}
+#endif
+
+#if HEAP_HANDLES
+// --- Handle and Compaction Tests ---
+
+#define FRAG_HANDLES 16
+#define FRAG_BIG_REQUEST 5000
+
+/**
+ * @brief Fills the heap with 400-byte handles and frees every other one,
+ * leaving no free block big enough for FRAG_BIG_REQUEST bytes.
+ */
+static void fragment_with_handles(HHandle *handles) {
+    for (int i = 0; i < FRAG_HANDLES; i++) {
+        handles[i] = hhandle_alloc(400);
+        TEST_ASSERT_NOT_NULL(handles[i]);
+        memset(hlock(handles[i]), 'a' + i, 400);
+        hunlock(handles[i]);
+    }
+    for (int i = 0; i < FRAG_HANDLES; i += 2) {
+        hhandle_free(handles[i]);
+    }
+}
+
+/**
+ * @brief Checks that the surviving handles kept their contents.
+ */
+static void check_and_free_odd_handles(HHandle *handles) {
+    for (int i = 1; i < FRAG_HANDLES; i += 2) {
+        const char *data = (const char *) hlock(handles[i]);
+        TEST_ASSERT_NOT_NULL(data);
+        TEST_ASSERT_EACH_EQUAL_CHAR('a' + i, data, 400);
+        hunlock(handles[i]);
+        hhandle_free(handles[i]);
+    }
+}
+
+/**
+ * @brief Verifies compaction merges the holes of a fragmented heap so a
+ * request larger than any hole succeeds.
+ */
+void test_compact_recovers_from_fragmentation(void) {
+    HHandle handles[FRAG_HANDLES];
+    fragment_with_handles(handles);
+
+#if !HEAP_NUMA
+    // Enough bytes are free in total, but not in one block.
+    TEST_ASSERT_NULL(my_malloc(FRAG_BIG_REQUEST));
+#endif
+
+    TEST_ASSERT_TRUE(allocator_compact() >= FRAG_BIG_REQUEST);
+    void *big = my_malloc(FRAG_BIG_REQUEST);
+    TEST_ASSERT_NOT_NULL(big);
+
+    check_and_free_odd_handles(handles);
+    my_free(big);
+}
+
+/**
+ * @brief Verifies hhandle_alloc compacts on its own when it has to.
+ */
+void test_hhandle_alloc_compacts_when_fragmented(void) {
+    HHandle handles[FRAG_HANDLES];
+    fragment_with_handles(handles);
+    void *before = *handles[FRAG_HANDLES - 1];
+
+    HHandle big = hhandle_alloc(FRAG_BIG_REQUEST);
+    TEST_ASSERT_NOT_NULL(big);
+#if !HEAP_NUMA
+    TEST_ASSERT_NOT_EQUAL(before, *handles[FRAG_HANDLES - 1]);
+#else
+    (void) before;
+#endif
+
+    check_and_free_odd_handles(handles);
+    hhandle_free(big);
+}
+
+/**
+ * @brief Verifies compaction moves only unlocked handles.
+ */
+void test_compact_keeps_locked_and_raw_blocks_in_place(void) {
+    char *raw = (char *) my_malloc(64);
+    HHandle a = hhandle_alloc(64);
+    HHandle b = hhandle_alloc(64);
+    HHandle c = hhandle_alloc(64);
+    HHandle d = hhandle_alloc(64);
+    TEST_ASSERT_NOT_NULL(raw);
+    TEST_ASSERT_NOT_NULL(d);
+    memset(raw, 'R', 64);
+    memset(hlock(d), 'D', 64);
+    hunlock(d);
+
+    char *pinned = (char *) hlock(b);
+    memset(pinned, 'B', 64);
+    void *hole = *c;
+    hhandle_free(a);
+    hhandle_free(c);
+
+    allocator_compact();
+
+    // 'd' slid into the hole left by 'c'; 'raw' and locked 'b' stayed.
+    TEST_ASSERT_EQUAL_PTR(hole, *d);
+    TEST_ASSERT_EQUAL_PTR(pinned, *b);
+    TEST_ASSERT_EACH_EQUAL_CHAR('D', *d, 64);
+    TEST_ASSERT_EACH_EQUAL_CHAR('B', pinned, 64);
+    TEST_ASSERT_EACH_EQUAL_CHAR('R', raw, 64);
+
+    // Handles are checked like pointers.
+    hhandle_free(c);
+    TEST_ASSERT_NULL(hlock(c));
+
+    hunlock(b);
+    hhandle_free(b);
+    hhandle_free(d);
+    my_free(raw);
+}
+#endif
+
+#if HEAP_FREE_INDEX
+// --- Free-Block Index Tests ---
+
+#define CHURN_SLOTS 24
+#define CHURN_STEPS 2000
+
+/**
+ * @brief Runs a fixed random alloc/free churn and records where each block
+ * landed, relative to the first one (the heap may move between runs).
+ *
+ * With 'toggle', list walks and index searches alternate, so each has to
+ * work on the free list as the other left it.
+ */
+static void run_churn(ptrdiff_t *seen, bool toggle) {
+    void *live[CHURN_SLOTS] = {0};
+    const char *origin = NULL;
+    uint32_t rng = 12345;
+    for (int step = 0; step < CHURN_STEPS; step++) {
+        if (toggle && step % 100 == 0) {
+            allocator_set_free_index(step % 200 == 0);
+        }
+        rng = rng * 1103515245u + 12345u;
+        size_t slot = (rng >> 16) % CHURN_SLOTS;
+        if (live[slot] != NULL) {
+            my_free(live[slot]);
+        }
+        live[slot] = my_malloc(8 + (rng >> 8) % 256);
+        if (origin == NULL) {
+            origin = (const char *) live[slot];
+        }
+        seen[step] = live[slot] ? (const char *) live[slot] - origin : -1;
+    }
+    for (int slot = 0; slot < CHURN_SLOTS; slot++) {
+        my_free(live[slot]);
+    }
+}
+
+/**
+ * @brief Verifies the index picks exactly the blocks the list walk picks.
+ */
+void test_free_index_matches_list_walk(void) {
+    static ptrdiff_t with_index[CHURN_STEPS];
+    static ptrdiff_t without_index[CHURN_STEPS];
+    bypass_guard_sampling();
+
+    run_churn(with_index, true);
+    allocator_set_free_index(false);
+    allocator_init();
+    run_churn(without_index, false);
+    allocator_set_free_index(true);
+
+#if !HEAP_NUMA
+    // NUMA placement follows the CPU the test happens to run on.
+    TEST_ASSERT_EQUAL_MEMORY(without_index, with_index, sizeof(with_index));
+#endif
+}
+
+/**
+ * @brief Verifies searches stay correct while the free list is longer than
+ * the index, and after the index is rebuilt as the list shrinks.
+ */
+void test_free_index_overflow_falls_back(void) {
+    enum { MAX_SMALL = HEAP_SIZE / 32 };
+    static void *small[MAX_SMALL];
+    bypass_guard_sampling();
+
+    size_t count = 0;
+    while (count < MAX_SMALL && (small[count] = my_malloc(8)) != NULL) {
+        count++;
+    }
+    for (size_t i = 0; i < count; i += 2) {
+        my_free(small[i]);
+    }
+    TEST_ASSERT_TRUE(count / 2 > HEAP_FREE_INDEX_CAPACITY);
+
+    // First fit takes the holes newest first, whichever search runs.
+    for (size_t i = (count - 1) & ~(size_t) 1;; i -= 2) {
+        void *ptr = my_malloc(8);
+#if HEAP_NUMA
+        TEST_ASSERT_NOT_NULL(ptr); // Holes are spread over the arenas.
+#else
+        TEST_ASSERT_EQUAL_PTR(small[i], ptr);
+#endif
+        small[i] = ptr;
+        if (i == 0) {
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        my_free(small[i]);
+    }
+}
+#endif
+
+#if HEAP_LATENCY
+// --- Latency Histogram Tests ---
+
+/**
+ * @brief Verifies every public call is recorded once, under its own
+ * operation, with ordered percentiles.
+ */
+void test_latency_counts_each_public_call(void) {
+    void *blocks[10];
+    for (int i = 0; i < 10; i++) {
+        blocks[i] = my_malloc(32 + (size_t) i);
+        TEST_ASSERT_NOT_NULL(blocks[i]);
+    }
+    // Grows, so it mallocs and frees inside; those are not counted.
+    blocks[0] = my_realloc(blocks[0], 512);
+    TEST_ASSERT_NOT_NULL(blocks[0]);
+    for (int i = 0; i < 10; i++) {
+        my_free(blocks[i]);
+    }
+
+    HeapLatencyStats stats;
+    allocator_get_latency_stats(HEAP_OP_MALLOC, &stats);
+    TEST_ASSERT_EQUAL_UINT64(10, stats.count);
+    TEST_ASSERT_TRUE(stats.p50_ns <= stats.p90_ns);
+    TEST_ASSERT_TRUE(stats.p90_ns <= stats.p99_ns);
+    TEST_ASSERT_TRUE(stats.p99_ns <= stats.p999_ns);
+    TEST_ASSERT_TRUE(stats.max_ns > 0);
+    TEST_ASSERT_TRUE(stats.max_ns <= stats.p999_ns);
+
+    allocator_get_latency_stats(HEAP_OP_FREE, &stats);
+    TEST_ASSERT_EQUAL_UINT64(10, stats.count);
+    allocator_get_latency_stats(HEAP_OP_REALLOC, &stats);
+    TEST_ASSERT_EQUAL_UINT64(1, stats.count);
+
+    allocator_reset_latency();
+    allocator_get_latency_stats(HEAP_OP_MALLOC, &stats);
+    TEST_ASSERT_EQUAL_UINT64(0, stats.count);
+}
+
+#if HEAP_POLICY == HEAP_POLICY_FIRST_FIT
+/**
+ * @brief Verifies malloc latencies are tied to the free blocks examined,
+ * and that the dump shows them.
+ */
+void test_latency_walk_tracks_free_list_length(void) {
+    bypass_guard_sampling();
+    // 20 small holes that a 64-byte request has to look past.
+    void *small[40];
+    for (int i = 0; i < 40; i++) {
+        small[i] = my_malloc(8);
+        TEST_ASSERT_NOT_NULL(small[i]);
+    }
+    for (int i = 0; i < 40; i += 2) {
+        my_free(small[i]);
+    }
+
+    allocator_reset_latency();
+    void *big[5];
+    for (int i = 0; i < 5; i++) {
+        big[i] = my_malloc(64);
+        TEST_ASSERT_NOT_NULL(big[i]);
+    }
+
+    HeapLatencyStats stats;
+    allocator_get_latency_stats(HEAP_OP_MALLOC, &stats);
+    TEST_ASSERT_EQUAL_UINT64(5, stats.count);
+    TEST_ASSERT_TRUE(stats.mean_walk >= 20);
+    TEST_ASSERT_TRUE(stats.tail_walk >= 20);
+
+    FILE *out = tmpfile();
+    TEST_ASSERT_NOT_NULL(out);
+    TEST_ASSERT_EQUAL_INT(0, allocator_dump_latency(out));
+    rewind(out);
+
+    char line[256];
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), out));
+    TEST_ASSERT_EQUAL_STRING_LEN("heap latency:", line, 13);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), out));
+    TEST_ASSERT_EQUAL_STRING_LEN("malloc: 5 calls", line, 15);
+    TEST_ASSERT_NOT_NULL(fgets(line, sizeof(line), out));
+    TEST_ASSERT_NOT_NULL(strstr(line, "(walk "));
+    fclose(out);
+
+    for (int i = 0; i < 5; i++) {
+        my_free(big[i]);
+    }
+    for (int i = 1; i < 40; i += 2) {
+        my_free(small[i]);
+    }
+}
+#endif
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+// --- TLSF Policy Tests ---
+
+/**
+ * @brief Verifies malloc and free stay within HEAP_TLSF_MAX_STEPS both on
+ * a fresh heap and after heavy fragmentation.
+ */
+void test_tlsf_steps_bounded_regardless_of_heap_state(void) {
+    bypass_guard_sampling();
+    HeapTlsfStats stats;
+    void *first = my_malloc(64);
+    TEST_ASSERT_NOT_NULL(first);
+    my_free(first);
+    allocator_get_tlsf_stats(&stats);
+    TEST_ASSERT_TRUE(stats.max_malloc_steps >= 1);
+    TEST_ASSERT_TRUE(stats.max_malloc_steps <= HEAP_TLSF_MAX_STEPS);
+    TEST_ASSERT_TRUE(stats.max_free_steps <= HEAP_TLSF_MAX_STEPS);
+
+    // Fill the heap with blocks of mixed sizes, punch holes in it, then
+    // churn randomly, including requests no hole can serve.
+    enum { SLOTS = 256 };
+    void *blocks[SLOTS] = {NULL};
+    uint64_t rng = 12345;
+    for (int i = 0; i < SLOTS; i++) {
+        rng = rng * 6364136223846793005u + 1442695040888963407u;
+        blocks[i] = my_malloc(8 + (size_t) (rng >> 33) % 120);
+    }
+    for (int i = 0; i < SLOTS; i += 2) {
+        my_free(blocks[i]);
+        blocks[i] = NULL;
+    }
+    for (int step = 0; step < 5000; step++) {
+        rng = rng * 6364136223846793005u + 1442695040888963407u;
+        size_t slot = (size_t) (rng >> 33) % SLOTS;
+        my_free(blocks[slot]);
+        blocks[slot] = my_malloc(8 + (size_t) (rng >> 40) % 600);
+    }
+
+    allocator_get_tlsf_stats(&stats);
+    TEST_ASSERT_TRUE(stats.max_malloc_steps <= HEAP_TLSF_MAX_STEPS);
+    TEST_ASSERT_TRUE(stats.max_free_steps <= HEAP_TLSF_MAX_STEPS);
+    TEST_ASSERT_TRUE(stats.max_free_steps >= 2); // Some frees merged.
+
+    // Everything merges back into the block the heap started with.
+    for (int i = 0; i < SLOTS; i++) {
+        my_free(blocks[i]);
+    }
+    void *again = my_malloc(HEAP_SIZE / 2);
+    TEST_ASSERT_EQUAL_PTR(first, again);
+    my_free(again);
+}
+
+/**
+ * @brief Verifies a freed block merges with free neighbours on both sides.
+ */
+void test_tlsf_coalesces_both_directions(void) {
+    bypass_guard_sampling();
+    char *a = (char *) my_malloc(64);
+    char *b = (char *) my_malloc(64);
+    char *c = (char *) my_malloc(64);
+    char *pin = (char *) my_malloc(64);
+    TEST_ASSERT_NOT_NULL(pin);
+
+    my_free(a);
+    my_free(c);
+    my_free(b); // Merges backwards into 'a' and forwards into 'c'.
+
+    // Only the merged block fits this below the rest of the heap.
+    char *merged = (char *) my_malloc(3 * 64);
+    TEST_ASSERT_EQUAL_PTR(a, merged);
+    TEST_ASSERT_TRUE(pin > merged + 3 * 64);
+
+    my_free(merged);
+    my_free(pin);
+}
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_BUDDY
+// --- Buddy Policy Tests ---
+
+/**
+ * @brief Verifies a split leaves two buddies side by side, and freeing both
+ * undoes every split.
+ */
+void test_buddy_splits_into_buddies_and_merges_back(void) {
+    bypass_guard_sampling();
+    HeapBuddyStats before;
+    allocator_get_buddy_stats(&before);
+
+    char *a = (char *) my_malloc(100);
+    char *b = (char *) my_malloc(100);
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    // 100 bytes plus header and prefix round up to a 256-byte block.
+    TEST_ASSERT_EQUAL_PTR(a + 256, b);
+
+    HeapBuddyStats stats;
+    allocator_get_buddy_stats(&stats);
+    TEST_ASSERT_TRUE(stats.splits >= 1);
+    TEST_ASSERT_EQUAL_size_t(0, stats.merges);
+
+    my_free(b);
+    my_free(a);
+    allocator_get_buddy_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(stats.splits, stats.merges);
+    TEST_ASSERT_EQUAL_size_t(before.largest_free, stats.largest_free);
+}
+
+/**
+ * @brief Verifies requests are served from power-of-two blocks, so one byte
+ * more than the largest block holds fails.
+ */
+void test_buddy_rounds_blocks_to_powers_of_two(void) {
+    bypass_guard_sampling();
+    HeapBuddyStats stats;
+    allocator_get_buddy_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(0, (stats.largest_free + sizeof(BlockHeader)) &
+                                    (stats.largest_free + sizeof(BlockHeader) -
+                                     1));
+
+    size_t fits =
+        stats.largest_free - MY_ALLOC_PREFIX_SIZE - MY_ALLOC_CANARY_SIZE;
+    void *whole = my_malloc(fits);
+    TEST_ASSERT_NOT_NULL(whole);
+    my_free(whole);
+    TEST_ASSERT_NULL(my_malloc(fits + 1));
+}
+#endif
+
+#if HEAP_BUDGETS
+// --- Memory Budget Tests ---
+
+/** @brief What the limit handler saw; it frees 'reserve' if set. */
+typedef struct {
+    int calls;
+    HeapLimitEvent last;
+    void *reserve;
+} LimitLog;
+
+static void record_limit(const HeapLimitEvent *event, void *ctx) {
+    LimitLog *log = (LimitLog *) ctx;
+    log->calls++;
+    log->last = *event;
+    if (log->reserve != NULL) {
+        my_free(log->reserve);
+        log->reserve = NULL;
+    }
+}
+
+/**
+ * @brief Verifies a tag's budget refuses allocations past its limit, tells
+ * the handler, and leaves other tags alone.
+ */
+void test_budget_refuses_tag_over_limit(void) {
+    bypass_guard_sampling();
+    LimitLog log = {0};
+    allocator_set_limit_handler(record_limit, &log);
+    allocator_set_budget(1, 1024);
+    TEST_ASSERT_EQUAL_UINT(0, allocator_set_thread_tag(1));
+
+    void *blocks[16];
+    size_t count = 0;
+    size_t per_block = 0;
+    while (count < 16 && (blocks[count] = my_malloc(256)) != NULL) {
+        count++;
+        if (count == 1) {
+            per_block = allocator_get_budget_usage(1);
+        }
+    }
+    TEST_ASSERT_TRUE(count >= 1 && count < 16);
+    TEST_ASSERT_EQUAL_size_t(count * per_block,
+                             allocator_get_budget_usage(1));
+    TEST_ASSERT_EQUAL_INT(1, log.calls);
+    TEST_ASSERT_EQUAL_INT(HEAP_LIMIT_BUDGET, log.last.reason);
+    TEST_ASSERT_EQUAL_UINT(1, log.last.tag);
+    TEST_ASSERT_EQUAL_size_t(1024, log.last.limit);
+    TEST_ASSERT_TRUE(log.last.usage + log.last.size > log.last.limit);
+
+    // Other tags are not limited; freed bytes can be allocated again.
+    allocator_set_thread_tag(0);
+    void *other = my_malloc(256);
+    TEST_ASSERT_NOT_NULL(other);
+    my_free(other);
+    allocator_set_thread_tag(1);
+    my_free(blocks[--count]);
+    blocks[count] = my_malloc(256);
+    TEST_ASSERT_NOT_NULL(blocks[count++]);
+
+    for (size_t i = 0; i < count; i++) {
+        my_free(blocks[i]);
+    }
+    TEST_ASSERT_EQUAL_size_t(0, allocator_get_budget_usage(1));
+    TEST_ASSERT_EQUAL_size_t(0, allocator_get_budget_usage(HEAP_BUDGET_TOTAL));
+
+    allocator_set_thread_tag(0);
+    allocator_set_budget(1, 0);
+    allocator_set_limit_handler(NULL, NULL);
+}
+
+/**
+ * @brief Verifies the handler hears about an exhausted heap and can shed
+ * memory so a retry succeeds.
+ */
+void test_budget_handler_sheds_on_out_of_memory(void) {
+    bypass_guard_sampling();
+    static void *blocks[HEAP_SIZE / 64 * TEST_HEAP_COUNT];
+    LimitLog log = {0};
+    log.reserve = my_malloc(1024);
+    TEST_ASSERT_NOT_NULL(log.reserve);
+    allocator_set_limit_handler(record_limit, &log);
+
+    size_t count = 0;
+    while ((blocks[count] = my_malloc(256)) != NULL) {
+        count++;
+    }
+    TEST_ASSERT_EQUAL_INT(1, log.calls);
+    TEST_ASSERT_EQUAL_INT(HEAP_LIMIT_NO_MEMORY, log.last.reason);
+    TEST_ASSERT_EQUAL_size_t(0, log.last.limit);
+    TEST_ASSERT_NULL(log.reserve);
+
+    blocks[count] = my_malloc(256); // The reserve made room.
+    TEST_ASSERT_NOT_NULL(blocks[count++]);
+
+    for (size_t i = 0; i < count; i++) {
+        my_free(blocks[i]);
+    }
+    allocator_set_limit_handler(NULL, NULL);
+}
+
+#if HEAP_THREAD_SAFE
+#define BUDGET_THREADS 4
+#define BUDGET_BLOCKS 10
+
+/** @brief Allocates under its own tag, frees half, and exits. */
+static void *budget_worker(void *arg) {
+    void **blocks = (void **) arg;
+    allocator_set_thread_tag((unsigned) (uintptr_t) blocks[0]);
+    for (int i = 0; i < BUDGET_BLOCKS; i++) {
+        blocks[i] = my_malloc(64);
+    }
+    for (int i = 0; i < BUDGET_BLOCKS; i += 2) {
+        my_free(blocks[i]);
+        blocks[i] = NULL;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Verifies threads that exit with unpublished balances still have
+ * them counted, and that another thread's frees uncharge their tags.
+ */
+void test_budget_counts_threads_that_exit(void) {
+    bypass_guard_sampling();
+    // Size of one charged block, measured under a spare tag.
+    allocator_set_thread_tag(BUDGET_THREADS + 1);
+    void *probe = my_malloc(64);
+    TEST_ASSERT_NOT_NULL(probe);
+    size_t per_block = allocator_get_budget_usage(BUDGET_THREADS + 1);
+    my_free(probe);
+    allocator_set_thread_tag(0);
+
+    static void *blocks[BUDGET_THREADS][BUDGET_BLOCKS];
+    pthread_t threads[BUDGET_THREADS];
+    for (uintptr_t t = 0; t < BUDGET_THREADS; t++) {
+        blocks[t][0] = (void *) (t + 1); // The worker's tag
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[t], NULL,
+                                                budget_worker, blocks[t]));
+    }
+    for (int t = 0; t < BUDGET_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    for (unsigned tag = 1; tag <= BUDGET_THREADS; tag++) {
+        TEST_ASSERT_EQUAL_size_t(BUDGET_BLOCKS / 2 * per_block,
+                                 allocator_get_budget_usage(tag));
+    }
+    TEST_ASSERT_EQUAL_size_t(BUDGET_THREADS * BUDGET_BLOCKS / 2 * per_block,
+                             allocator_get_budget_usage(HEAP_BUDGET_TOTAL));
+
+    for (int t = 0; t < BUDGET_THREADS; t++) {
+        for (int i = 0; i < BUDGET_BLOCKS; i++) {
+            TEST_ASSERT_TRUE(i % 2 == 0 || blocks[t][i] != NULL);
+            my_free(blocks[t][i]);
+        }
+    }
+    TEST_ASSERT_EQUAL_size_t(0, allocator_get_budget_usage(HEAP_BUDGET_TOTAL));
+}
+#endif
+#endif
+
+#if HEAP_MAINTENANCE
+// --- Background Maintenance Tests ---
+
+// Passes run by hand; the thread itself would wait a minute.
+#define MAINTENANCE_IDLE_MS 60000
+
+/**
+ * @brief Verifies frees are deferred while the thread runs and that a pass
+ * merges two neighbouring deferred blocks into one.
+ */
+void test_maintenance_merges_deferred_frees(void) {
+    bypass_guard_sampling();
+    TEST_ASSERT_EQUAL_INT(0, allocator_start_maintenance(MAINTENANCE_IDLE_MS));
+    TEST_ASSERT_EQUAL_INT(-1,
+                          allocator_start_maintenance(MAINTENANCE_IDLE_MS));
+
+    // Too large for the caches.
+    void *a = my_malloc(300);
+    void *b = my_malloc(300);
+    void *c = my_malloc(300);
+    TEST_ASSERT_NOT_NULL(c);
+    my_free(a);
+    my_free(b);
+
+    HeapMaintenanceStats stats;
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(2, stats.deferred_frees);
+    TEST_ASSERT_EQUAL_size_t(0, stats.merges);
+
+    allocator_run_maintenance();
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_GREATER_OR_EQUAL(1, stats.merges);
+    void *merged = my_malloc(600);
+    TEST_ASSERT_EQUAL_PTR(a, merged);
+
+    my_free(merged);
+    my_free(c);
+    allocator_stop_maintenance();
+
+    // Stopping merged everything back.
+    void *all = my_malloc(HEAP_SIZE / 2);
+    TEST_ASSERT_NOT_NULL(all);
+    my_free(all);
+}
+
+/**
+ * @brief Verifies small blocks are recycled through the per-size caches,
+ * and that a pass refills the caches that were asked for.
+ */
+void test_maintenance_caches_serve_small_sizes(void) {
+    bypass_guard_sampling();
+    TEST_ASSERT_EQUAL_INT(0, allocator_start_maintenance(MAINTENANCE_IDLE_MS));
+
+    void *first = my_malloc(40);
+    TEST_ASSERT_NOT_NULL(first);
+    my_free(first);
+    void *again = my_malloc(40);
+    TEST_ASSERT_EQUAL_PTR(first, again);
+
+    HeapMaintenanceStats stats;
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(1, stats.cache_misses);
+    TEST_ASSERT_EQUAL_size_t(1, stats.cache_hits);
+    TEST_ASSERT_EQUAL_size_t(0, stats.deferred_frees);
+
+    allocator_run_maintenance();
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(2, stats.cache_refills);
+
+    void *refilled = my_malloc(40);
+    TEST_ASSERT_NOT_NULL(refilled);
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(2, stats.cache_hits);
+
+    my_free(again);
+    my_free(refilled);
+    allocator_stop_maintenance();
+}
+
+/**
+ * @brief Verifies a malloc that finds no fit has the thread run a pass,
+ * and waits for it, only when blocks freed since the last pass could be
+ * merged into one.
+ */
+void test_maintenance_miss_pass_needs_unmerged_frees(void) {
+    bypass_guard_sampling();
+    TEST_ASSERT_EQUAL_INT(0, allocator_start_maintenance(MAINTENANCE_IDLE_MS));
+    HeapMaintenanceStats stats;
+    allocator_get_maintenance_stats(&stats);
+    size_t passes = stats.passes;
+
+    // Nothing was freed: there is nothing for a pass to merge.
+    TEST_ASSERT_NULL(my_malloc(HEAP_SIZE));
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(passes, stats.passes);
+
+    my_free(my_malloc(300));
+    TEST_ASSERT_NULL(my_malloc(HEAP_SIZE));
+    TEST_ASSERT_NULL(my_malloc(HEAP_SIZE));
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(passes + 1, stats.passes);
+
+    allocator_stop_maintenance();
+}
+
+#if HEAP_BACKEND == HEAP_BACKEND_MMAP
+/**
+ * @brief Verifies free blocks idle for a whole pass are returned to the OS
+ * and remain usable.
+ */
+void test_maintenance_releases_idle_pages(void) {
+    TEST_ASSERT_EQUAL_INT(0, allocator_start_maintenance(MAINTENANCE_IDLE_MS));
+
+    HeapMaintenanceStats stats;
+    allocator_run_maintenance();
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_EQUAL_size_t(0, stats.released_bytes);
+
+    allocator_run_maintenance();
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_GREATER_THAN(0, stats.released_bytes);
+
+    char *ptr = (char *) my_malloc(HEAP_SIZE / 2);
+    TEST_ASSERT_NOT_NULL(ptr);
+    memset(ptr, 'R', HEAP_SIZE / 2);
+    my_free(ptr);
+    allocator_stop_maintenance();
+}
+#endif
+
+#define MAINTENANCE_THREADS 4
+#define MAINTENANCE_SLOTS 16
+#define MAINTENANCE_STEPS 20000
+
+/**
+ * @brief Allocates, fills, checks and frees random small blocks.
+ *
+ * @return NULL, or a non-NULL value if a block was overwritten.
+ */
+static void *maintenance_worker(void *arg) {
+    uintptr_t id = (uintptr_t) arg;
+    unsigned char *slots[MAINTENANCE_SLOTS] = {NULL};
+    size_t sizes[MAINTENANCE_SLOTS] = {0};
+    uint32_t rng = (uint32_t) id * 2654435761u + 1;
+    void *result = NULL;
+
+    for (int step = 0; step < MAINTENANCE_STEPS; step++) {
+        rng = rng * 1103515245u + 12345u;
+        size_t slot = (rng >> 16) % MAINTENANCE_SLOTS;
+        unsigned char fill = (unsigned char) (id * MAINTENANCE_SLOTS + slot);
+        if (slots[slot] == NULL) {
+            sizes[slot] = 8 + (rng >> 8) % 120;
+            slots[slot] = (unsigned char *) my_malloc(sizes[slot]);
+            if (slots[slot] != NULL) {
+                memset(slots[slot], fill, sizes[slot]);
+            }
+            continue;
+        }
+        for (size_t i = 0; i < sizes[slot]; i++) {
+            if (slots[slot][i] != fill) {
+                result = arg; // Still freed below, but reported.
+            }
+        }
+        my_free(slots[slot]);
+        slots[slot] = NULL;
+    }
+
+    for (size_t slot = 0; slot < MAINTENANCE_SLOTS; slot++) {
+        my_free(slots[slot]);
+    }
+    return result;
+}
+
+/**
+ * @brief Verifies blocks stay intact while threads allocate and free
+ * alongside the maintenance thread and passes run by hand.
+ */
+void test_maintenance_races_with_allocating_threads(void) {
+    bypass_guard_sampling();
+    TEST_ASSERT_EQUAL_INT(0, allocator_start_maintenance(1));
+
+    pthread_t threads[MAINTENANCE_THREADS];
+    for (uintptr_t t = 0; t < MAINTENANCE_THREADS; t++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[t], NULL,
+                                                maintenance_worker,
+                                                (void *) (t + 1)));
+    }
+    for (int i = 0; i < 100; i++) {
+        allocator_run_maintenance();
+    }
+    for (int t = 0; t < MAINTENANCE_THREADS; t++) {
+        void *corrupted = NULL;
+        pthread_join(threads[t], &corrupted);
+        TEST_ASSERT_NULL(corrupted);
+    }
+    allocator_stop_maintenance();
+
+    HeapMaintenanceStats stats;
+    allocator_get_maintenance_stats(&stats);
+    TEST_ASSERT_GREATER_OR_EQUAL(100, stats.passes);
+    TEST_ASSERT_GREATER_THAN(0, stats.cache_hits);
+
+    void *all = my_malloc(HEAP_SIZE / 2);
+    TEST_ASSERT_NOT_NULL(all);
+    my_free(all);
+#if HEAP_DEBUG_GUARD
+    HeapGuardStats guard;
+    allocator_get_guard_stats(&guard);
+    TEST_ASSERT_EQUAL_UINT(0, guard.canary_failures);
+#endif
+}
+#endif
+
+#if HEAP_ISOLATION
+// --- Cache-Line Isolation Tests ---
+
+#define ISOLATION_THREADS 3
+#define ISOLATION_OBJECTS 16
+
+/** @brief Cache line holding byte 'i' of 'ptr'. */
+static uintptr_t line_of(const void *ptr, size_t i) {
+    return ((uintptr_t) ptr + i) / HEAP_CACHE_LINE;
+}
+
+static void *isolated_worker(void *arg) {
+    void **objects = (void **) arg;
+    for (int i = 0; i < ISOLATION_OBJECTS; i++) {
+        objects[i] = my_malloc_hint(sizeof(uint64_t), HINT_ISOLATED);
+        if (objects[i] != NULL) {
+            *(uint64_t *) objects[i] = (uint64_t) i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Verifies isolated objects of different threads never share a
+ * line while those of one thread are packed, and that the runs are
+ * returned once their objects are freed by another thread.
+ */
+void test_isolated_objects_never_share_lines(void) {
+    bypass_guard_sampling();
+    void *objects[ISOLATION_THREADS][ISOLATION_OBJECTS];
+    pthread_t threads[ISOLATION_THREADS];
+    for (int t = 0; t < ISOLATION_THREADS; t++) {
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[t], NULL,
+                                                isolated_worker, objects[t]));
+    }
+    for (int t = 0; t < ISOLATION_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    for (int t = 0; t < ISOLATION_THREADS; t++) {
+        TEST_ASSERT_EQUAL_PTR(objects[t][0],
+                              (char *) objects[t][1] - 2 * sizeof(size_t) -
+                                  sizeof(uint64_t));
+        TEST_ASSERT_EQUAL_UINT(line_of(objects[t][0], 0),
+                               line_of(objects[t][1], 0));
+        for (int i = 0; i < ISOLATION_OBJECTS; i++) {
+            TEST_ASSERT_NOT_NULL(objects[t][i]);
+            for (int u = 0; u < t; u++) {
+                for (int j = 0; j < ISOLATION_OBJECTS; j++) {
+                    TEST_ASSERT_NOT_EQUAL(
+                        line_of(objects[t][i], sizeof(uint64_t) - 1),
+                        line_of(objects[u][j], 0));
+                    TEST_ASSERT_NOT_EQUAL(
+                        line_of(objects[t][i], 0),
+                        line_of(objects[u][j], sizeof(uint64_t) - 1));
+                }
+            }
+        }
+    }
+
+    for (int t = 0; t < ISOLATION_THREADS; t++) {
+        for (int i = 0; i < ISOLATION_OBJECTS; i++) {
+            TEST_ASSERT_EQUAL_UINT64((uint64_t) i, *(uint64_t *) objects[t][i]);
+            TEST_ASSERT_EQUAL_size_t(sizeof(uint64_t),
+                                     my_malloc_usable_size(objects[t][i]));
+            my_free(objects[t][i]);
+        }
+    }
+
+    // The threads have exited, so their runs went with the last object.
+    void *all = my_malloc(HEAP_SIZE / 2);
+    TEST_ASSERT_NOT_NULL(all);
+    my_free(all);
+}
+
+/**
+ * @brief Verifies the per-thread mode, large isolated objects, and
+ * realloc and sized free of carved objects.
+ */
+void test_isolation_thread_mode(void) {
+    TEST_ASSERT_FALSE(allocator_set_thread_isolation(true));
+
+    char *small = my_malloc(10);
+    TEST_ASSERT_NOT_NULL(small);
+    TEST_ASSERT_EQUAL_size_t(10, my_malloc_usable_size(small));
+    memcpy(small, "isolated!", 10);
+
+    // Too large for a run: a block of whole lines.
+    size_t large_size = HEAP_ISOLATION_RUN_SIZE / 2;
+    char *large = my_malloc(large_size);
+    TEST_ASSERT_NOT_NULL(large);
+    TEST_ASSERT_EQUAL_UINT(0, (uintptr_t) large % HEAP_CACHE_LINE);
+    TEST_ASSERT_GREATER_OR_EQUAL(large_size, my_malloc_usable_size(large));
+
+    small = my_realloc(small, 100);
+    TEST_ASSERT_NOT_NULL(small);
+    TEST_ASSERT_EQUAL_STRING("isolated!", small);
+    TEST_ASSERT_EQUAL_size_t(100, my_malloc_usable_size(small));
+
+    size_t actual = 0;
+    void *least = my_malloc_at_least(24, &actual);
+    TEST_ASSERT_NOT_NULL(least);
+    TEST_ASSERT_EQUAL_size_t(24, actual);
+
+    my_free_sized(least, 24);
+    my_free(small);
+    my_free_sized(large, large_size);
+
+    // Sized frees of whole-line objects go back to the heap; leaking them
+    // would exhaust it long before the loop ends.
+    for (size_t i = 0; i < 4 * HEAP_SIZE / large_size; i++) {
+        large = my_malloc(large_size);
+        TEST_ASSERT_NOT_NULL(large);
+        my_free_sized(large, large_size);
+    }
+
+    TEST_ASSERT_TRUE(allocator_set_thread_isolation(false));
+}
+
+/**
+ * @brief Verifies a free of a pointer whose offset word merely has the
+ * isolation tag set is reported and leaves the heap intact.
+ */
+void test_isolation_rejects_invalid_interior_free(void) {
+    bypass_guard_sampling();
+    size_t *block = (size_t *) my_malloc(64);
+    TEST_ASSERT_NOT_NULL(block);
+
+    block[0] = 0x12345671;
+    my_free(block + 1);
+    // Leads back into the heap, to memory that holds no run.
+    block[0] = (HEAP_CACHE_LINE + sizeof(size_t)) | 1;
+    my_free(block + 1);
+
+    my_free(block);
+    TEST_ASSERT_EQUAL_PTR(block, my_malloc(64));
+}
+#endif
+
+#if HEAP_REGIONS
+// --- Memory Region Tests ---
+
+// A small fast region between two slow ones, as on a board with TCM.
+static char slow_low_ram[8192] __attribute__((aligned(ALIGNMENT)));
+static char fast_ram[4096] __attribute__((aligned(ALIGNMENT)));
+static char slow_high_ram[8192] __attribute__((aligned(ALIGNMENT)));
+
+enum { REGION_SLOW_LOW, REGION_FAST, REGION_SLOW_HIGH, REGION_COUNT };
+
+static const HeapRegion test_regions[REGION_COUNT] = {
+    {slow_low_ram, sizeof(slow_low_ram), 0, 0},
+    {fast_ram, sizeof(fast_ram), 1, HEAP_REGION_FAST},
+    {slow_high_ram, sizeof(slow_high_ram), 5, HEAP_REGION_DMA},
+};
+
+/**
+ * @brief Verifies small and hot requests go to the fast region, others to
+ * the slow region of highest priority, and HINT_REGION() is honored.
+ */
+void test_regions_place_by_size_hint_and_priority(void) {
+    bypass_guard_sampling();
+    TEST_ASSERT_EQUAL_INT(0,
+                          allocator_init_regions(test_regions, REGION_COUNT));
+
+    void *small = my_malloc(32);
+    void *large = my_malloc(1024);
+    void *hot = my_malloc_hint(1024, HINT_HOT);
+    void *dma = my_malloc_hint(32, HINT_REGION(HEAP_REGION_DMA));
+    TEST_ASSERT_EQUAL_INT(REGION_FAST, allocator_region_of(small));
+    TEST_ASSERT_EQUAL_INT(REGION_SLOW_HIGH, allocator_region_of(large));
+    TEST_ASSERT_EQUAL_INT(REGION_FAST, allocator_region_of(hot));
+    TEST_ASSERT_EQUAL_INT(REGION_SLOW_HIGH, allocator_region_of(dma));
+
+    // No region has this attribute.
+    TEST_ASSERT_NULL(my_malloc_hint(32, HINT_REGION(0x80)));
+
+    my_free(small);
+    my_free(large);
+    my_free(hot);
+    my_free(dma);
+    large = my_malloc(1024);
+    TEST_ASSERT_EQUAL_INT(REGION_SLOW_HIGH, allocator_region_of(large));
+    my_free(large);
+
+    allocator_init();
+}
+
+/**
+ * @brief Verifies small requests spill to the slow regions once the fast
+ * one is full, and that frees find their region again.
+ */
+void test_regions_fall_back_and_free_to_owner(void) {
+    bypass_guard_sampling();
+    TEST_ASSERT_EQUAL_INT(0,
+                          allocator_init_regions(test_regions, REGION_COUNT));
+
+    void *blocks[256];
+    size_t count = 0;
+    do {
+        blocks[count] = my_malloc(32);
+        TEST_ASSERT_NOT_NULL(blocks[count]);
+    } while (allocator_region_of(blocks[count++]) == REGION_FAST &&
+             count < 256);
+    TEST_ASSERT_GREATER_THAN(1, count);
+    TEST_ASSERT_EQUAL_INT(REGION_SLOW_HIGH,
+                          allocator_region_of(blocks[count - 1]));
+
+    // Freed in reverse, the fast region takes small requests again.
+    while (count > 0) {
+        my_free(blocks[--count]);
+    }
+    void *again = my_malloc(32);
+    TEST_ASSERT_EQUAL_INT(REGION_FAST, allocator_region_of(again));
+    my_free(again);
+
+    int local = 0;
+    TEST_ASSERT_EQUAL_INT(-1, allocator_region_of(&local));
+    TEST_ASSERT_EQUAL_INT(-1, allocator_region_of(NULL));
+
+    allocator_init();
+}
+
+/**
+ * @brief Verifies invalid region sets are rejected and leave the allocator
+ * empty, and that allocator_init() restores the static heap.
+ */
+void test_regions_reject_invalid_layouts(void) {
+    const HeapRegion overlapping[2] = {
+        {slow_low_ram, sizeof(slow_low_ram), 0, 0},
+        {slow_low_ram + 4096, 1024, 1, HEAP_REGION_FAST},
+    };
+    const HeapRegion tiny = {fast_ram, sizeof(BlockHeader), 0, 0};
+    const HeapRegion missing = {NULL, 1024, 0, 0};
+
+    TEST_ASSERT_EQUAL_INT(-1, allocator_init_regions(overlapping, 2));
+    TEST_ASSERT_NULL(my_malloc(32));
+    TEST_ASSERT_EQUAL_INT(-1, allocator_init_regions(&tiny, 1));
+    TEST_ASSERT_EQUAL_INT(-1, allocator_init_regions(&missing, 1));
+    TEST_ASSERT_EQUAL_INT(-1, allocator_init_regions(test_regions, 0));
+    TEST_ASSERT_EQUAL_INT(
+        -1, allocator_init_regions(test_regions, HEAP_MAX_REGIONS + 1));
+
+    allocator_init();
+    void *ptr = my_malloc(32);
+    TEST_ASSERT_EQUAL_INT(0, allocator_region_of(ptr));
+    my_free(ptr);
+}
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_FILE
+// --- Persistent Heap Tests ---
+
+#define TEST_HEAP_FILE "test_persistent.heap"
+
+/** @brief List node stored in the heap file, linked by offset. */
+typedef struct {
+    size_t next;
+    int value;
+} PersistNode;
+
+/**
+ * @brief Verifies a heap reopened at a different address keeps its data,
+ * root and free list.
+ */
+void test_file_heap_survives_reopen_at_new_address(void) {
+    unlink(TEST_HEAP_FILE);
+    TEST_ASSERT_EQUAL_INT(0, allocator_open_file(TEST_HEAP_FILE, HEAP_SIZE));
+
+    size_t head = BLOCK_NONE;
+    PersistNode *nodes[3];
+    for (int i = 0; i < 3; i++) {
+        nodes[i] = (PersistNode *) my_malloc(sizeof(PersistNode));
+        TEST_ASSERT_NOT_NULL(nodes[i]);
+        nodes[i]->value = i;
+        nodes[i]->next = head;
+        head = allocator_ptr_to_offset(nodes[i]);
+    }
+    allocator_set_root(nodes[2]);
+    TEST_ASSERT_EQUAL_PTR(nodes[2], allocator_get_root());
+    allocator_destroy();
+
+    // Occupy the old address range so the file is mapped somewhere else.
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    void *old_page = (void *) ((uintptr_t) nodes[0] & ~(uintptr_t) (page - 1));
+    void *blocker = mmap(old_page, page, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    TEST_ASSERT_TRUE(blocker != MAP_FAILED);
+
+    TEST_ASSERT_EQUAL_INT(0, allocator_open_file(TEST_HEAP_FILE, HEAP_SIZE));
+    PersistNode *node = (PersistNode *) allocator_get_root();
+    TEST_ASSERT_NOT_NULL(node);
+    if (blocker == old_page) {
+        TEST_ASSERT_NOT_EQUAL(nodes[2], node);
+    }
+
+    PersistNode *live[3];
+    for (int expected = 2; expected >= 0; expected--) {
+        TEST_ASSERT_NOT_NULL(node);
+        TEST_ASSERT_EQUAL_INT(expected, node->value);
+        live[expected] = node;
+        node = (PersistNode *) allocator_offset_to_ptr(node->next);
+    }
+    TEST_ASSERT_NULL(node);
+
+    // The free list was resumed, so new blocks avoid the live nodes.
+    void *fresh = my_malloc(sizeof(PersistNode));
+    TEST_ASSERT_NOT_NULL(fresh);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_NOT_EQUAL(live[i], fresh);
+    }
+    my_free(fresh);
+    my_free(live[0]);
+    TEST_ASSERT_EQUAL_INT(0, allocator_sync());
+
+    allocator_destroy();
+    munmap(blocker, page);
+    unlink(TEST_HEAP_FILE);
+}
+
+/**
+ * @brief Verifies a file that is not a heap is refused.
+ */
+void test_file_heap_rejects_foreign_file(void) {
+    FILE *file = fopen(TEST_HEAP_FILE, "wb");
+    TEST_ASSERT_NOT_NULL(file);
+    for (int i = 0; i < 256; i++) {
+        fputc('x', file);
+    }
+    fclose(file);
+
+    TEST_ASSERT_EQUAL_INT(-1, allocator_open_file(TEST_HEAP_FILE, HEAP_SIZE));
+    TEST_ASSERT_NULL(my_malloc(16));
+    TEST_ASSERT_NULL(allocator_get_root());
+    unlink(TEST_HEAP_FILE);
+}
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+// --- Shared-Memory Heap Tests ---
+
+#define TEST_SHM_NAME "/heapengine-test"
+
+/**
+ * @brief Verifies a buffer allocated by one process can be read in place
+ * and freed by another, which received only its offset.
+ */
+void test_shm_buffer_handoff_between_processes(void) {
+    allocator_unlink_shared(TEST_SHM_NAME);
+    TEST_ASSERT_EQUAL_INT(0, allocator_open_shared(TEST_SHM_NAME, HEAP_SIZE));
+
+    int to_child[2];
+    int to_parent[2];
+    TEST_ASSERT_EQUAL_INT(0, pipe(to_child));
+    TEST_ASSERT_EQUAL_INT(0, pipe(to_parent));
+
+    pid_t pid = fork();
+    TEST_ASSERT_TRUE(pid >= 0);
+    if (pid == 0) {
+        // Attach afresh, as an unrelated process would.
+        int ok = allocator_open_shared(TEST_SHM_NAME, HEAP_SIZE) == 0;
+        size_t offset = BLOCK_NONE;
+        ok = ok && read(to_child[0], &offset, sizeof(offset)) ==
+                       (ssize_t) sizeof(offset);
+        unsigned char *buf = (unsigned char *) allocator_offset_to_ptr(offset);
+        ok = ok && buf != NULL;
+        for (int i = 0; ok && i < 256; i++) {
+            ok = buf[i] == (unsigned char) i;
+        }
+        if (ok) {
+            my_free(buf);
+        }
+        char done = 'd';
+        ok = ok && write(to_parent[1], &done, 1) == 1;
+        _exit(ok ? 0 : 1);
+    }
+
+    unsigned char *buf = (unsigned char *) my_malloc(256);
+    TEST_ASSERT_NOT_NULL(buf);
+    for (int i = 0; i < 256; i++) {
+        buf[i] = (unsigned char) i;
+    }
+    size_t offset = allocator_ptr_to_offset(buf);
+    TEST_ASSERT_EQUAL_INT((int) sizeof(offset),
+                          (int) write(to_child[1], &offset, sizeof(offset)));
+
+    char done = 0;
+    TEST_ASSERT_EQUAL_INT(1, (int) read(to_parent[0], &done, 1));
+    int status = 0;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+
+    // The child's my_free is visible here: the block is reused.
+    TEST_ASSERT_EQUAL_PTR(buf, my_malloc(256));
+
+    close(to_child[0]);
+    close(to_child[1]);
+    close(to_parent[0]);
+    close(to_parent[1]);
+    allocator_destroy();
+    allocator_unlink_shared(TEST_SHM_NAME);
+}
+
+/**
+ * @brief Verifies allocator_init() in a second process attaches to the
+ * live segment instead of formatting it under the first one's buffers.
+ */
+void test_shm_init_attaches_to_live_segment(void) {
+    unsigned char *buf = (unsigned char *) my_malloc(64);
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(buf, 0x5A, 64);
+    size_t offset = allocator_ptr_to_offset(buf);
+
+    pid_t pid = fork();
+    TEST_ASSERT_TRUE(pid >= 0);
+    if (pid == 0) {
+        allocator_init();
+        const unsigned char *seen =
+            (const unsigned char *) allocator_offset_to_ptr(offset);
+        int ok = seen != NULL;
+        for (int i = 0; ok && i < 64; i++) {
+            ok = seen[i] == 0x5A;
+        }
+        // A fresh heap would hand out the same block again.
+        ok = ok && my_malloc(64) != seen;
+        _exit(ok ? 0 : 1);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+    for (int i = 0; i < 64; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0x5A, buf[i]);
+    }
+    my_free(buf);
+}
+
+/**
+ * @brief Keeps a ring of live blocks, checking each one before freeing it.
+ *
+ * @return Number of blocks whose contents were changed by someone else.
+ */
+static int shm_churn(unsigned char tag) {
+    unsigned char *live[16] = {NULL};
+    size_t sizes[16] = {0};
+    int corrupted = 0;
+
+    for (int i = 0; i < 20000; i++) {
+        int slot = i % 16;
+        for (size_t j = 0; live[slot] != NULL && j < sizes[slot]; j++) {
+            if (live[slot][j] != tag) {
+                corrupted++;
+                break;
+            }
+        }
+        my_free(live[slot]);
+
+        sizes[slot] = 16 + (size_t) (i % 7) * 24;
+        live[slot] = (unsigned char *) my_malloc(sizes[slot]);
+        if (live[slot] != NULL) {
+            memset(live[slot], tag, sizes[slot]);
+        }
+    }
+
+    for (int slot = 0; slot < 16; slot++) {
+        my_free(live[slot]);
+    }
+    return corrupted;
+}
+
+/**
+ * @brief Verifies two processes allocating concurrently never receive
+ * overlapping blocks.
+ */
+void test_shm_concurrent_processes_do_not_overlap(void) {
+    allocator_unlink_shared(TEST_SHM_NAME);
+    TEST_ASSERT_EQUAL_INT(0, allocator_open_shared(TEST_SHM_NAME, HEAP_SIZE));
+
+    pid_t pid = fork();
+    TEST_ASSERT_TRUE(pid >= 0);
+    if (pid == 0) {
+        _exit(shm_churn('c') == 0 ? 0 : 1);
+    }
+
+    TEST_ASSERT_EQUAL_INT(0, shm_churn('p'));
+    int status = 0;
+    waitpid(pid, &status, 0);
+    TEST_ASSERT_TRUE(WIFEXITED(status));
+    TEST_ASSERT_EQUAL_INT(0, WEXITSTATUS(status));
+
+    TEST_ASSERT_NOT_NULL(my_malloc(64));
+    allocator_destroy();
+    allocator_unlink_shared(TEST_SHM_NAME);
+}
+#endif
+
+/**
+ * @brief Main function to run all unit tests.
+ *
+ */
+int main(void) {
+    UNITY_BEGIN(); // Sets up Unity
+
+    // --- Malloc Tests ---
+    RUN_TEST(test_malloc_basic_should_return_non_null);
+    RUN_TEST(test_malloc_should_split_large_block);
+    RUN_TEST(test_malloc_should_return_aligned_memory);
+    RUN_TEST(test_malloc_zero_size);
+    RUN_TEST(test_malloc_fails_when_heap_too_small);
+    RUN_TEST(test_malloc_constant_size_uses_size_class);
+    RUN_TEST(test_malloc_dispatches_only_constant_sizes);
+
+    // --- Free Tests ---
+    RUN_TEST(test_free_should_reuse_memory);
+    RUN_TEST(test_free_should_coalesce_adjacent_blocks);
+    RUN_TEST(test_free_null_pointer);
+    RUN_TEST(test_invalid_free);
+    RUN_TEST(test_double_free);
+    RUN_TEST(test_free_sized_should_reuse_memory);
+    RUN_TEST(test_free_sized_rejects_wrong_size);
+    RUN_TEST(test_free_sized_checks_header_at_fixed_distance);
+
+    // --- Calloc Tests ---
+    RUN_TEST(test_calloc_should_return_zeroed_memory);
+    RUN_TEST(test_calloc_should_fail_on_overflow);
+
+    // --- Realloc Tests ---
+    RUN_TEST(test_realloc_null_ptr_acts_like_malloc);
+    RUN_TEST(test_realloc_zero_size_acts_like_free);
+    RUN_TEST(test_realloc_should_shrink_block);
+    RUN_TEST(test_realloc_grow_block_new_location);
+
+    // --- Usable Size and Alignment Tests ---
+    RUN_TEST(test_usable_size_covers_request);
+    RUN_TEST(test_malloc_at_least_reports_capacity);
+    RUN_TEST(test_usable_size_of_null_and_failures);
+    RUN_TEST(test_malloc_aligned_returns_aligned_blocks);
+
+#if HEAP_POLICY == HEAP_POLICY_FIRST_FIT
+    // --- Allocation Hint Tests ---
+    RUN_TEST(test_malloc_hint_separates_long_and_short_lived);
+    RUN_TEST(test_malloc_hint_hot_blocks_stay_contiguous);
+#endif
+
+    // --- Scenario Tests ---
+    RUN_TEST(test_fragmentation_scenario);
+    RUN_TEST(test_exhaust_heap);
+
+#if HEAP_DEBUG_GUARD
+    // --- Hardened Debug Mode Tests ---
+    RUN_TEST(test_debug_canary_detects_overflow);
+    RUN_TEST(test_debug_guard_page_traps_overflow_and_use_after_free);
+    RUN_TEST(test_debug_guard_sampling_and_realloc);
+#endif
+
+#if HEAP_CHECKPOINT
+    // --- Checkpoint Tests ---
+    RUN_TEST(test_checkpoint_rollback_releases_new_allocations);
+    RUN_TEST(test_checkpoint_rollback_restores_freed_blocks);
+    RUN_TEST(test_checkpoint_nested_rollback);
+    RUN_TEST(test_checkpoint_nested_at_same_position);
+    RUN_TEST(test_checkpoint_rollback_after_many_allocations);
+    RUN_TEST(test_checkpoint_rejects_stale_and_overflowed);
+#endif
+
+#if HEAP_NUMA
+    // --- NUMA Tests ---
+    RUN_TEST(test_numa_allocations_prefer_local_node);
+    RUN_TEST(test_numa_falls_back_to_remote_node);
+#endif
+
+#if HEAP_PROFILER
+    // --- Heap Profiler Tests ---
+    RUN_TEST(test_profiler_tracks_live_sampled_allocations);
+    RUN_TEST(test_profiler_default_period_skips_small_allocations);
+#endif
+
+#if HEAP_HANDLES
+    // --- Handle and Compaction Tests ---
+    RUN_TEST(test_compact_recovers_from_fragmentation);
+    RUN_TEST(test_hhandle_alloc_compacts_when_fragmented);
+    RUN_TEST(test_compact_keeps_locked_and_raw_blocks_in_place);
+#endif
+
+#if HEAP_FREE_INDEX
+    // --- Free-Block Index Tests ---
+    RUN_TEST(test_free_index_matches_list_walk);
+    RUN_TEST(test_free_index_overflow_falls_back);
+#endif
+
+#if HEAP_LATENCY
+    // --- Latency Histogram Tests ---
+    RUN_TEST(test_latency_counts_each_public_call);
+#if HEAP_POLICY == HEAP_POLICY_FIRST_FIT
+    RUN_TEST(test_latency_walk_tracks_free_list_length);
+#endif
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_TLSF
+    // --- TLSF Policy Tests ---
+    RUN_TEST(test_tlsf_steps_bounded_regardless_of_heap_state);
+    RUN_TEST(test_tlsf_coalesces_both_directions);
+#endif
+
+#if HEAP_POLICY == HEAP_POLICY_BUDDY
+    // --- Buddy Policy Tests ---
+    RUN_TEST(test_buddy_splits_into_buddies_and_merges_back);
+    RUN_TEST(test_buddy_rounds_blocks_to_powers_of_two);
+#endif
+
+#if HEAP_BUDGETS
+    // --- Memory Budget Tests ---
+    RUN_TEST(test_budget_refuses_tag_over_limit);
+    RUN_TEST(test_budget_handler_sheds_on_out_of_memory);
+#if HEAP_THREAD_SAFE
+    RUN_TEST(test_budget_counts_threads_that_exit);
+#endif
+#endif
+
+#if HEAP_MAINTENANCE
+    // --- Background Maintenance Tests ---
+    RUN_TEST(test_maintenance_merges_deferred_frees);
+    RUN_TEST(test_maintenance_caches_serve_small_sizes);
+    RUN_TEST(test_maintenance_miss_pass_needs_unmerged_frees);
+#if HEAP_BACKEND == HEAP_BACKEND_MMAP
+    RUN_TEST(test_maintenance_releases_idle_pages);
+#endif
+    RUN_TEST(test_maintenance_races_with_allocating_threads);
+#endif
+
+#if HEAP_ISOLATION
+    // --- Cache-Line Isolation Tests ---
+    RUN_TEST(test_isolated_objects_never_share_lines);
+    RUN_TEST(test_isolation_thread_mode);
+    RUN_TEST(test_isolation_rejects_invalid_interior_free);
+#endif
+
+#if HEAP_REGIONS
+    // --- Memory Region Tests ---
+    RUN_TEST(test_regions_place_by_size_hint_and_priority);
+    RUN_TEST(test_regions_fall_back_and_free_to_owner);
+    RUN_TEST(test_regions_reject_invalid_layouts);
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_FILE
+    // --- Persistent Heap Tests ---
+    RUN_TEST(test_file_heap_survives_reopen_at_new_address);
+    RUN_TEST(test_file_heap_rejects_foreign_file);
+#endif
+
+#if HEAP_BACKEND == HEAP_BACKEND_SHM
+    // --- Shared-Memory Heap Tests ---
+    RUN_TEST(test_shm_buffer_handoff_between_processes);
+    RUN_TEST(test_shm_init_attaches_to_live_segment);
+    RUN_TEST(test_shm_concurrent_processes_do_not_overlap);
+#endif
 
     return UNITY_END(); // Reports the results
 }
\ No newline at end of file